@@ -0,0 +1,93 @@
+/*
+ * backend.c - Allocators that mdriver can replay traces against
+ *     (see backend.h)
+ */
+#define _GNU_SOURCE     /* for RTLD_DEEPBIND */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <dlfcn.h>
+
+#include "backend.h"
+#include "mm.h"
+#include "memlib.h"
+
+static backend_t mm_backend = {
+	"mm", mm_init, mem_reset_brk, mm_malloc, mm_free, mm_realloc,
+	mem_heapsize, NULL
+};
+
+static backend_t libc_backend = {
+	"libc", NULL, NULL, malloc, free, realloc, NULL, NULL
+};
+
+/*
+ * backend_load - Load an allocator from a shared object. RTLD_DEEPBIND
+ *     makes its own calls to malloc or mem_sbrk resolve inside it rather
+ *     than to mdriver's.
+ */
+static backend_t *backend_load(const char *path, const char **err)
+{
+	backend_t *b;
+	void *h;
+	void (*setup)(void);
+	const char *base;
+	int flags = RTLD_NOW | RTLD_LOCAL;
+
+#ifdef RTLD_DEEPBIND
+	flags |= RTLD_DEEPBIND;
+#endif
+	if ((h = dlopen(path, flags)) == NULL) {
+		*err = dlerror();
+		return NULL;
+	}
+	if ((b = calloc(1, sizeof(backend_t))) == NULL) {
+		*err = "out of memory";
+		dlclose(h);
+		return NULL;
+	}
+	b->handle = h;
+	base = strrchr(path, '/');
+	snprintf(b->name, BACKEND_NAMELEN, "%s", base ? base + 1 : path);
+
+	if ((b->malloc = (void *(*)(size_t))dlsym(h, "mm_malloc")) != NULL) {
+		/* the mm.c interface, on a memlib heap */
+		b->init = (int (*)(void))dlsym(h, "mm_init");
+		b->free = (void (*)(void *))dlsym(h, "mm_free");
+		b->realloc = (void *(*)(void *, size_t))dlsym(h, "mm_realloc");
+		b->reset = (void (*)(void))dlsym(h, "mem_reset_brk");
+		b->heap_size = (size_t (*)(void))dlsym(h, "mem_heapsize");
+		if ((setup = (void (*)(void))dlsym(h, "mem_init")) != NULL)
+			setup();
+	}
+	else {
+		/* a malloc replacement */
+		b->malloc = (void *(*)(size_t))dlsym(h, "malloc");
+		b->free = (void (*)(void *))dlsym(h, "free");
+		b->realloc = (void *(*)(void *, size_t))dlsym(h, "realloc");
+	}
+	if (b->malloc == NULL || b->free == NULL || b->realloc == NULL) {
+		*err = "exports neither mm_malloc/mm_free/mm_realloc nor "
+			"malloc/free/realloc";
+		free(b);
+		dlclose(h);
+		return NULL;
+	}
+	return b;
+}
+
+backend_t *backend_open(const char *name, const char **err)
+{
+	if (!strcmp(name, "mm"))
+		return &mm_backend;
+	if (!strcmp(name, "libc"))
+		return &libc_backend;
+	return backend_load(name, err);
+}
+
+int backend_init(backend_t *b)
+{
+	if (b->reset != NULL)
+		b->reset();
+	return (b->init != NULL) ? b->init() : 0;
+}
@@ -0,0 +1,44 @@
+/*
+ * backend.h - Allocators that mdriver can replay traces against
+ *
+ * A backend is a table of the functions mdriver needs. Besides the mm.c
+ * it is linked with and the C library, backends can be loaded from
+ * shared objects (mdriver -b), so that several allocators are compared
+ * in one run under the same conditions. A shared object either exports
+ * the mm.c interface (mm_init, mm_malloc, mm_free, mm_realloc), as the
+ * mmbackend.so target of the Makefile does, or is a malloc replacement
+ * exporting malloc, free and realloc, such as libmm32.so. The object
+ * must match mdriver's word size: the native libmm.so cannot be loaded
+ * into the default -m32 mdriver. A path without a '/' is looked up
+ * like a library by dlopen, so name files in the current directory as
+ * ./name.so.
+ */
+#ifndef __BACKEND_H_
+#define __BACKEND_H_
+
+#include <stddef.h>
+
+#define BACKEND_NAMELEN 64
+
+typedef struct {
+	char name[BACKEND_NAMELEN];
+	int (*init)(void);              /* set up an empty heap, -1 on failure */
+	void (*reset)(void);            /* discard the heap, before init */
+	void *(*malloc)(size_t size);
+	void (*free)(void *ptr);
+	void *(*realloc)(void *ptr, size_t size);
+	size_t (*heap_size)(void);      /* bytes taken from the system */
+	void *handle;                   /* from dlopen, NULL if built in */
+} backend_t;
+
+/*
+ * Find a backend: "mm" and "libc" name the built-in ones, anything else
+ * is the path of a shared object to load. Returns NULL, with the reason
+ * in *err, if it cannot be loaded. Optional functions are NULL.
+ */
+backend_t *backend_open(const char *name, const char **err);
+
+/* Start a replay on an empty heap: reset, then init; -1 on failure */
+int backend_init(backend_t *b);
+
+#endif /* __BACKEND_H_ */
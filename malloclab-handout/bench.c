@@ -0,0 +1,127 @@
+/*
+ * bench.c - Repeated timing with confidence intervals (see bench.h)
+ *
+ * Outliers are runs outside Tukey's fences, more than 1.5 interquartile
+ * ranges beyond the quartiles; they are usually a run that was
+ * interrupted or migrated. The confidence interval of the median is the
+ * distribution-free one, between the order statistics at (1-based) ranks
+ * n/2 - 1.96 sqrt(n)/2 and 1 + n/2 + 1.96 sqrt(n)/2, so it does not
+ * assume the times are normal. It is taken over all n runs: order
+ * statistics are not moved by a few outliers, while dropping them first
+ * would narrow the interval below its 95% coverage.
+ */
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "bench.h"
+
+#define Z95 1.96
+
+/*
+ * now - Seconds on the monotonic clock
+ */
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+/*
+ * quantile - The q quantile of n sorted values, interpolated
+ */
+static double quantile(double *v, int n, double q)
+{
+	double pos = q * (n - 1);
+	int i = (int)pos;
+
+	if (i >= n - 1)
+		return v[n - 1];
+	return v[i] + (pos - i) * (v[i + 1] - v[i]);
+}
+
+/*
+ * summarize - Fill in r's confidence interval from all n times, then
+ *     reject the outliers and fill in the rest from the kept times;
+ *     sorted is scratch space for n values
+ */
+static void summarize(double *times, double *sorted, int n, bench_result_t *r)
+{
+	double q1, q3, iqr, sum = 0, sumsq = 0;
+	int i, k = 0, lo, hi;
+
+	for (i = 0; i < n; i++)
+		sorted[i] = times[i];
+	qsort(sorted, n, sizeof(double), cmp_double);
+
+	/* 1-based ranks of the interval's ends */
+	lo = (int)floor(n / 2.0 - Z95 * sqrt(n) / 2);
+	hi = (int)ceil(1 + n / 2.0 + Z95 * sqrt(n) / 2);
+	r->lo = sorted[(lo < 1) ? 0 : lo - 1];
+	r->hi = sorted[(hi > n) ? n - 1 : hi - 1];
+
+	q1 = quantile(sorted, n, 0.25);
+	q3 = quantile(sorted, n, 0.75);
+	iqr = q3 - q1;
+	for (i = 0; i < n; i++)
+		if (sorted[i] >= q1 - 1.5 * iqr && sorted[i] <= q3 + 1.5 * iqr)
+			sorted[k++] = sorted[i];
+
+	r->runs = n;
+	r->outliers = n - k;
+	r->median = quantile(sorted, k, 0.5);
+	for (i = 0; i < k; i++) {
+		sum += sorted[i];
+		sumsq += sorted[i] * sorted[i];
+	}
+	r->mean = sum / k;
+	r->sd = (k > 1) ? sqrt(fmax(0, (sumsq - sum * sum / k) / (k - 1))) : 0;
+}
+
+void bench_defaults(bench_opts_t *o)
+{
+	o->warmup = 2;
+	o->min_runs = 10;
+	o->max_runs = 200;
+	o->rel_ci = 0.01;
+}
+
+int bench(bench_funct setup, bench_funct run, void *argp, bench_opts_t *o,
+		bench_result_t *r)
+{
+	double *times, *sorted, start;
+	int i, n;
+
+	if ((times = malloc(2 * o->max_runs * sizeof(double))) == NULL)
+		return -1;
+	sorted = times + o->max_runs;
+
+	for (i = 0; i < o->warmup; i++) {
+		if (setup != NULL)
+			setup(argp);
+		run(argp);
+	}
+	for (n = 0; n < o->max_runs; ) {
+		if (setup != NULL)
+			setup(argp);
+		start = now();
+		run(argp);
+		times[n++] = now() - start;
+		if (n >= o->min_runs || n == o->max_runs) {
+			summarize(times, sorted, n, r);
+			if ((r->hi - r->lo) / 2 <= o->rel_ci * r->median)
+				break;
+		}
+	}
+	free(times);
+	return 0;
+}
@@ -0,0 +1,40 @@
+/*
+ * bench.h - Repeated timing with warm-up, outlier rejection and a
+ *     confidence interval for the median
+ *
+ * The function under test is run a few times untimed, then timed run by
+ * run with a monotonic clock until the 95% confidence interval of the
+ * median is narrow enough or the run limit is reached. An optional setup
+ * function runs before every run, outside the timed region.
+ */
+#ifndef __BENCH_H_
+#define __BENCH_H_
+
+typedef void (*bench_funct)(void *);
+
+typedef struct {
+	int warmup;        /* untimed runs before the first timed one */
+	int min_runs;      /* timed runs before the interval is checked */
+	int max_runs;      /* give up on the interval after this many */
+	double rel_ci;     /* target half-width of the interval / median */
+} bench_opts_t;
+
+typedef struct {
+	int runs;          /* timed runs */
+	int outliers;      /* runs rejected as outliers */
+	double median;     /* median time of the kept runs, in seconds */
+	double lo, hi;     /* 95% confidence interval of the median, all runs */
+	double mean, sd;   /* mean and standard deviation of the kept runs */
+} bench_result_t;
+
+/* Fill in the default options: 2 warm-up runs, 10 to 200 runs, 1% */
+void bench_defaults(bench_opts_t *o);
+
+/*
+ * Time run(argp), calling setup(argp) first each time if it is not NULL.
+ * Returns -1 if there is no memory for the times.
+ */
+int bench(bench_funct setup, bench_funct run, void *argp, bench_opts_t *o,
+		bench_result_t *r);
+
+#endif /* __BENCH_H_ */
@@ -0,0 +1,224 @@
+/*
+ * cachesim.c - Set-associative cache and TLB model (see cachesim.h)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cachesim.h"
+
+#define MAXWAYS 64
+#define NOTAG   (~0ULL)
+
+/* One level of the model */
+typedef struct {
+	const char *name;
+	unsigned long size;        /* bytes, or entries for the TLB */
+	int ways;
+	unsigned long line;        /* line, or page, bytes */
+	int shift;                 /* log2(line) */
+	unsigned long sets;
+	unsigned long long *tags;  /* sets * ways line numbers */
+	unsigned long long *used;  /* when each way was last referenced */
+} level_t;
+
+int sim_on;
+
+static level_t levels[SIM_NLEVELS] = {
+	{"l1", 32768, 8, 64},
+	{"l2", 1048576, 16, 64},
+	{"tlb", 64, 4, 4096},
+};
+static size_t sim_base;
+static unsigned long long clock_tick;
+static sim_stats_t counts;
+
+/*
+ * log2_exact - log2 of x, or -1 if x is not a power of two
+ */
+static int log2_exact(unsigned long x)
+{
+	int n = 0;
+
+	if (x == 0 || (x & (x - 1)))
+		return -1;
+	while ((1UL << n) != x)
+		n++;
+	return n;
+}
+
+/*
+ * parse_size - A number with an optional k or m suffix
+ */
+static int parse_size(const char *s, char **end, unsigned long *v)
+{
+	*v = strtoul(s, end, 10);
+	if (*end == s)
+		return -1;
+	if (**end == 'k' || **end == 'K') {
+		*v <<= 10;
+		(*end)++;
+	}
+	else if (**end == 'm' || **end == 'M') {
+		*v <<= 20;
+		(*end)++;
+	}
+	return 0;
+}
+
+/*
+ * setup_level - Check the geometry of l and size its arrays
+ */
+static int setup_level(level_t *l)
+{
+	unsigned long entries;
+
+	if ((l->shift = log2_exact(l->line)) < 0 || l->ways < 1 ||
+			l->ways > MAXWAYS)
+		return -1;
+	entries = (l == &levels[SIM_TLB]) ? l->size : l->size / l->line;
+	if (entries < (unsigned long)l->ways || entries % l->ways ||
+			log2_exact(entries / l->ways) < 0)
+		return -1;
+	l->sets = entries / l->ways;
+	free(l->tags);
+	free(l->used);
+	l->tags = (unsigned long long *)malloc(entries * sizeof(*l->tags));
+	l->used = (unsigned long long *)malloc(entries * sizeof(*l->used));
+	if (l->tags == NULL || l->used == NULL)
+		return -1;
+	return 0;
+}
+
+/*
+ * sim_config - Apply name=size:ways:line,... over the current model
+ */
+int sim_config(const char *spec)
+{
+	const char *p = spec;
+	char *end;
+	unsigned long size, ways, line;
+	size_t len;
+	int i;
+
+	if (strcmp(spec, "default") == 0)
+		p = "";
+	while (*p != '\0') {
+		for (i = 0; i < SIM_NLEVELS; i++) {
+			len = strlen(levels[i].name);
+			if (strncmp(p, levels[i].name, len) == 0 && p[len] == '=')
+				break;
+		}
+		if (i == SIM_NLEVELS)
+			return -1;
+		p += len + 1;
+		if (parse_size(p, &end, &size) < 0 || *end != ':' ||
+				parse_size(end + 1, &end, &ways) < 0 || *end != ':' ||
+				parse_size(end + 1, &end, &line) < 0 ||
+				(*end != ',' && *end != '\0'))
+			return -1;
+		levels[i].size = size;
+		levels[i].ways = (int)ways;
+		levels[i].line = line;
+		p = (*end == ',') ? end + 1 : end;
+	}
+	for (i = 0; i < SIM_NLEVELS; i++)
+		if (setup_level(&levels[i]) < 0)
+			return -1;
+	return 0;
+}
+
+/*
+ * sim_describe - The model in one line
+ */
+const char *sim_describe(void)
+{
+	static char buf[160];
+
+	sprintf(buf, "L1 %luKB %d-way, L2 %luKB %d-way, %luB lines; "
+			"TLB %lu entries %d-way, %luKB pages",
+			levels[SIM_L1].size >> 10, levels[SIM_L1].ways,
+			levels[SIM_L2].size >> 10, levels[SIM_L2].ways,
+			levels[SIM_L1].line, levels[SIM_TLB].size, levels[SIM_TLB].ways,
+			levels[SIM_TLB].line >> 10);
+	return buf;
+}
+
+/*
+ * sim_start - Empty every level and start counting from base
+ */
+void sim_start(void *base)
+{
+	int i;
+
+	if (levels[0].tags == NULL && sim_config("default") < 0) {
+		fprintf(stderr, "cachesim: bad default model\n");
+		exit(1);
+	}
+	for (i = 0; i < SIM_NLEVELS; i++) {
+		memset(levels[i].tags, 0xFF,
+				levels[i].sets * levels[i].ways * sizeof(*levels[i].tags));
+		memset(levels[i].used, 0,
+				levels[i].sets * levels[i].ways * sizeof(*levels[i].used));
+	}
+	memset(&counts, 0, sizeof(counts));
+	clock_tick = 0;
+	sim_base = (size_t)base;
+	sim_on = 1;
+}
+
+/*
+ * sim_stop - Stop counting and return the counts
+ */
+void sim_stop(sim_stats_t *stats)
+{
+	sim_on = 0;
+	*stats = counts;
+}
+
+/*
+ * lookup - Reference offset in l, filling the least recently used way
+ *     of its set on a miss; returns 1 on a miss
+ */
+static int lookup(level_t *l, size_t offset)
+{
+	unsigned long long tag = offset >> l->shift;
+	unsigned long long *tags = &l->tags[(tag & (l->sets - 1)) * l->ways];
+	unsigned long long *used = &l->used[(tag & (l->sets - 1)) * l->ways];
+	int w, victim = 0;
+
+	clock_tick++;
+	for (w = 0; w < l->ways; w++) {
+		if (tags[w] == tag) {
+			used[w] = clock_tick;
+			return 0;
+		}
+		if (used[w] < used[victim])
+			victim = w;
+	}
+	tags[victim] = tag;
+	used[victim] = clock_tick;
+	return 1;
+}
+
+/*
+ * sim_ref - Send every L1 line of [addr, addr + n) through the model
+ */
+size_t sim_ref(size_t addr, size_t n, int src)
+{
+	size_t offset, last;
+	int shift = levels[SIM_L1].shift;
+
+	if (n == 0)
+		return addr;
+	last = (addr - sim_base + n - 1) >> shift;
+	for (offset = (addr - sim_base) >> shift; offset <= last; offset++) {
+		counts.refs[src]++;
+		counts.miss[SIM_TLB][src] += lookup(&levels[SIM_TLB], offset << shift);
+		if (lookup(&levels[SIM_L1], offset << shift)) {
+			counts.miss[SIM_L1][src]++;
+			counts.miss[SIM_L2][src] += lookup(&levels[SIM_L2], offset << shift);
+		}
+	}
+	return addr;
+}
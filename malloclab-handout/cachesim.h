@@ -0,0 +1,63 @@
+/*
+ * cachesim.h - Set-associative cache and TLB model for scoring heap
+ *     layouts (mdriver -C)
+ *
+ * Every reference is split into cache lines and each line goes through
+ * the TLB and L1, and through L2 when it misses in L1. All three levels
+ * are LRU. Addresses are taken relative to the base given to sim_start,
+ * so the counts depend only on the trace, the allocator and the model,
+ * never on where the heap happens to be mapped.
+ *
+ * mm.c feeds its header, footer and free-list references through
+ * SIM_REF, and the payloads realloc moves through SIM_COPY, when it is
+ * built with MM_SIM=1 (make mdriver-sim); otherwise both cost nothing.
+ */
+#ifndef __CACHESIM_H_
+#define __CACHESIM_H_
+
+#include <stddef.h>
+
+enum {SIM_L1, SIM_L2, SIM_TLB, SIM_NLEVELS};
+
+/* Who made a reference: mm.c's bookkeeping or the program's payloads */
+enum {SIM_META, SIM_PAYLOAD, SIM_NSRC};
+
+typedef struct {
+	unsigned long long refs[SIM_NSRC];             /* lines referenced */
+	unsigned long long miss[SIM_NLEVELS][SIM_NSRC];
+} sim_stats_t;
+
+extern int sim_on;  /* set between sim_start and sim_stop */
+
+/*
+ * Change the model from a list like "l1=32k:8:64,l2=1m:16:64,tlb=64:4:4k"
+ * (bytes:ways:line bytes for the caches, entries:ways:page bytes for the
+ * TLB). Levels that are not named keep their defaults, which the word
+ * "default" leaves alone. Returns -1 if the list is not valid.
+ */
+int sim_config(const char *spec);
+
+/* One-line description of the model */
+const char *sim_describe(void);
+
+/* Empty every level, zero the counts and start counting */
+void sim_start(void *base);
+void sim_stop(sim_stats_t *stats);
+
+/* Reference n bytes at addr; returns addr */
+size_t sim_ref(size_t addr, size_t n, int src);
+
+#if MM_SIM
+#define SIM_REF(p,n) (sim_on ? sim_ref((size_t)(p),(n),SIM_META) : (size_t)(p))
+#define SIM_COPY(dst,src,n) do { \
+	if(sim_on) { \
+		sim_ref((size_t)(src),(n),SIM_PAYLOAD); \
+		sim_ref((size_t)(dst),(n),SIM_PAYLOAD); \
+	} \
+} while(0)
+#else
+#define SIM_REF(p,n) (p)
+#define SIM_COPY(dst,src,n)
+#endif
+
+#endif /* __CACHESIM_H_ */
@@ -9,6 +9,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <time.h>
 #include <sys/times.h>
 #include "clock.h"
 
@@ -71,6 +72,38 @@ double get_counter()
 }
 /* $end x86cyclecounter */
 
+#elif defined(__x86_64__)
+/*******************************************************
+ * x86-64 versions of start_counter() and get_counter()
+ *
+ * The time stamp counter of current processors ticks at a constant
+ * rate whatever the clock speed (the invariant TSC), so it measures
+ * elapsed time rather than cycles executed. Plain rdtsc may be executed
+ * before earlier instructions finish or after later ones start; the
+ * fences keep the timed code between the two reads.
+ *******************************************************/
+
+static unsigned long long cyc_start = 0;
+
+/* Read the counter before any later instruction executes */
+static inline unsigned long long rdtsc_end(void)
+{
+    unsigned hi, lo, aux;
+
+    asm volatile("rdtscp; lfence" : "=a" (lo), "=d" (hi), "=c" (aux) : : "memory");
+    return ((unsigned long long)hi << 32) | lo;
+}
+
+void start_counter()
+{
+    cyc_start = read_counter();   /* fenced behind earlier instructions */
+}
+
+double get_counter()
+{
+    return (double)(rdtsc_end() - cyc_start);
+}
+
 #elif defined(__alpha)
 
 /****************************************************
@@ -195,12 +228,114 @@ double mhz_full(int verbose, int sleeptime)
 }
 /* $end mhz */
 
-/* Version using a default sleeptime */
+/* Version using the TSC rate where it is known, else a default sleeptime */
 double mhz(int verbose)
 {
-    return mhz_full(verbose, 2);
+    double rate = tsc_mhz(verbose);
+
+    return (rate > 0) ? rate : mhz_full(verbose, 2);
 }
 
+/** Time stamp counter calibration */
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <cpuid.h>
+
+/* Does the TSC tick at a constant rate in every P- and C-state? */
+int tsc_invariant(void)
+{
+    unsigned a, b, c, d;
+
+    if (!__get_cpuid(0x80000007, &a, &b, &c, &d))
+	return 0;
+    return (d >> 8) & 1;
+}
+
+/* The TSC rate the kernel calibrated at boot, where it exports it */
+static double tsc_mhz_sysfs(void)
+{
+    FILE *fp = fopen("/sys/devices/system/cpu/cpu0/tsc_freq_khz", "r");
+    double khz = 0;
+
+    if (fp == NULL)
+	return 0;
+    if (fscanf(fp, "%lf", &khz) != 1)
+	khz = 0;
+    fclose(fp);
+    return khz / 1e3;
+}
+
+/* The TSC rate from CPUID leaf 0x15 (TSC to crystal clock ratio) */
+static double tsc_mhz_cpuid(void)
+{
+    unsigned a, b, c, d;
+
+    if (__get_cpuid_max(0, NULL) < 0x15)
+	return 0;
+    __cpuid_count(0x15, 0, a, b, c, d);
+    if (a == 0 || b == 0 || c == 0)
+	return 0;   /* crystal clock not enumerated */
+    return (double)c * b / a / 1e6;
+}
+
+/* Count TSC ticks across about 20 ms of the kernel's monotonic clock */
+static double tsc_mhz_measured(void)
+{
+    struct timespec t0, t1;
+    unsigned long long c0, c1;
+    double nsecs;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    c0 = read_counter();
+    do {
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	nsecs = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+    } while (nsecs < 2e7);
+    c1 = read_counter();
+    return (c1 - c0) / (nsecs / 1e3);
+}
+
+/*
+ * tsc_mhz - The rate of the TSC, from the kernel if it exports it, then
+ *     from CPUID, then measured against the kernel's clock. Returns 0
+ *     when the TSC is not invariant, since its rate then follows the
+ *     clock speed and cannot be known in advance.
+ */
+double tsc_mhz(int verbose)
+{
+    static double rate = -1;
+    const char *source = "kernel";
+
+    if (rate >= 0)
+	return rate;
+    if (!tsc_invariant()) {
+	if (verbose)
+	    printf("TSC is not invariant; timing it against sleep\n");
+	return rate = 0;
+    }
+    if ((rate = tsc_mhz_sysfs()) <= 0) {
+	source = "CPUID";
+	if ((rate = tsc_mhz_cpuid()) <= 0) {
+	    source = "measured";
+	    rate = tsc_mhz_measured();
+	}
+    }
+    if (verbose)
+	printf("Invariant TSC rate = %.1f MHz (%s)\n", rate, source);
+    return rate;
+}
+#else
+int tsc_invariant(void)
+{
+    return 0;
+}
+
+double tsc_mhz(int verbose)
+{
+    return 0;
+}
+#endif
+
 /** Special counters that compensate for timer interrupt overhead */
 
 static double cyc_per_tick = 0.0;
@@ -277,3 +412,57 @@ double get_comp_counter()
     return ctime;
 }
 
+/** Raw counter for timing single operations */
+
+#if defined(__i386__) || defined(__x86_64__)
+/* lfence keeps the read from running ahead of the code before it */
+unsigned long long read_counter(void)
+{
+    unsigned hi, lo;
+
+    asm volatile("lfence; rdtsc" : "=a" (lo), "=d" (hi) : : "memory");
+    return ((unsigned long long)hi << 32) | lo;
+}
+#else
+unsigned long long read_counter(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+#endif
+
+/* Take the smallest of many back-to-back differences */
+double counter_overhead(void)
+{
+    unsigned long long t0, t1, best = ~0ULL;
+    int i;
+
+    for (i = 0; i < 10000; i++) {
+	t0 = read_counter();
+	t1 = read_counter();
+	if (t1 - t0 < best)
+	    best = t1 - t0;
+    }
+    return (double)best;
+}
+
+/*
+ * The calibrated TSC rate, or else the ticks counted against the kernel's
+ * clock; found once
+ */
+double counter_ghz(void)
+{
+    static double ghz = 0.0;
+
+    if (ghz > 0.0)
+	return ghz;
+#if defined(__i386__) || defined(__x86_64__)
+    if ((ghz = tsc_mhz(0) / 1e3) <= 0.0)
+	ghz = tsc_mhz_measured() / 1e3;
+#else
+    ghz = 1.0;   /* read_counter counts nanoseconds */
+#endif
+    return ghz;
+}
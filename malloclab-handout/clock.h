@@ -9,9 +9,15 @@ double get_counter();
 /* Measure overhead for counter */
 double ovhd();
 
-/* Determine clock rate of processor (using a default sleeptime) */
+/* Determine clock rate of processor (the TSC rate, or using a default sleeptime) */
 double mhz(int verbose);
 
+/* Rate of an invariant TSC in MHz, calibrated by the kernel; 0 if none */
+double tsc_mhz(int verbose);
+
+/* 1 if the TSC ticks at a constant rate whatever the clock speed */
+int tsc_invariant(void);
+
 /* Determine clock rate of processor, having more control over accuracy */
 double mhz_full(int verbose, int sleeptime);
 
@@ -20,3 +26,14 @@ double mhz_full(int verbose, int sleeptime);
 void start_comp_counter();
 
 double get_comp_counter();
+
+/** Raw counter for timing single operations */
+
+/* Read the time stamp counter (nanoseconds where there is none) */
+unsigned long long read_counter(void);
+
+/* Smallest difference between two back-to-back read_counter calls */
+double counter_overhead(void);
+
+/* Counter ticks per nanosecond */
+double counter_ghz(void);
@@ -8,6 +8,7 @@
  * the time in CPU cycles for a function f.
  */
 #include <stdlib.h>
+#include <string.h>
 #include <sys/times.h>
 #include <stdio.h>
 
@@ -20,22 +21,26 @@
 #define EPSILON 0.01         /* K samples should be EPSILON of each other*/
 #define COMPENSATE 0         /* 1-> try to compensate for clock ticks */
 #define CLEAR_CACHE 0        /* Clear cache before running test function */
-#define CACHE_BYTES (1<<19)  /* Max cache size in bytes */
-#define CACHE_BLOCK 32       /* Cache block size in bytes */
+#define CACHE_BYTES (1<<19)  /* Max cache size in bytes, if not found */
+#define CACHE_BLOCK 32       /* Cache block size in bytes, if not found */
 
 static int kbest = K;
 static int maxsamples = MAXSAMPLES;
 static double epsilon = EPSILON;
 static int compensate = COMPENSATE;
 static int clear_cache = CLEAR_CACHE;
-static int cache_bytes = CACHE_BYTES;
-static int cache_block = CACHE_BLOCK;
+static int cache_bytes = 0;  /* 0 until looked up (see find_cache) */
+static int cache_block = 0;
 
 static int *cache_buf = NULL;
 
 static double *values = NULL;
 static int samplecount = 0;
 
+/* How the K best samples of the last fcyc call compare */
+static int last_samples = 0;
+static double last_spread = 0;
+
 /* for debugging only */
 #define KEEP_VALS 0
 #define KEEP_SAMPLES 0
@@ -97,6 +102,61 @@ static int has_converged()
 	((1 + epsilon)*values[0] >= values[kbest-1]);
 }
 
+/*
+ * sysfs_cache - Read a value of cache index idx of CPU 0 from sysfs;
+ *     sizes are given there as "32768K"
+ */
+static int sysfs_cache(int idx, const char *name)
+{
+    char path[128], unit = 0;
+    FILE *fp;
+    int val = 0;
+
+    sprintf(path, "/sys/devices/system/cpu/cpu0/cache/index%d/%s", idx, name);
+    if ((fp = fopen(path, "r")) == NULL)
+	return -1;
+    if (fscanf(fp, "%d%c", &val, &unit) < 1)
+	val = -1;
+    fclose(fp);
+    if (unit == 'K')
+	val <<= 10;
+    else if (unit == 'M')
+	val <<= 20;
+    return val;
+}
+
+/*
+ * find_cache - Size the buffer that clears the cache from the host's
+ *     last-level data cache, as sysfs reports it, unless the sizes were
+ *     set with set_fcyc_cache_size/block
+ */
+static void find_cache()
+{
+    int idx, level, best = 0, bytes = 0, block = 0;
+    char type[16];
+    FILE *fp;
+
+    for (idx = 0; (level = sysfs_cache(idx, "level")) > 0; idx++) {
+	char path[128];
+
+	sprintf(path, "/sys/devices/system/cpu/cpu0/cache/index%d/type", idx);
+	if ((fp = fopen(path, "r")) == NULL)
+	    continue;
+	if (fscanf(fp, "%15s", type) != 1)
+	    type[0] = '\0';
+	fclose(fp);
+	if (!strcmp(type, "Instruction") || level < best)
+	    continue;
+	best = level;
+	bytes = sysfs_cache(idx, "size");
+	block = sysfs_cache(idx, "coherency_line_size");
+    }
+    if (cache_bytes == 0)
+	cache_bytes = (bytes > 0) ? bytes : CACHE_BYTES;
+    if (cache_block == 0)
+	cache_block = (block > 0) ? block : CACHE_BLOCK;
+}
+
 /* 
  * clear - Code to clear cache 
  */
@@ -106,13 +166,18 @@ static void clear()
 {
     int x = sink;
     int *cptr, *cend;
-    int incr = cache_block/sizeof(int);
+    int incr;
+    if (!cache_bytes || !cache_block)
+	find_cache();
+    incr = cache_block/sizeof(int);
     if (!cache_buf) {
 	cache_buf = malloc(cache_bytes);
 	if (!cache_buf) {
 	    fprintf(stderr, "Fatal error.  Malloc returned null when trying to clear cache\n");
 	    exit(1);
 	}
+	/* untouched pages all map the one zero page, which would stay cached */
+	memset(cache_buf, 1, cache_bytes);
     }
     cptr = (int *) cache_buf;
     cend = cptr + cache_bytes/sizeof(int);
@@ -160,6 +225,8 @@ double fcyc(test_funct f, void *argp)
     }
 #endif
     result = values[0];
+    last_samples = samplecount;
+    last_spread = (samplecount >= kbest) ? values[kbest-1]/values[0] - 1 : -1;
 #if !KEEP_VALS
     free(values); 
     values = NULL;
@@ -168,6 +235,28 @@ double fcyc(test_funct f, void *argp)
 }
 
 
+/*
+ * fcyc_converged - Did the K best samples of the last fcyc call come
+ *     within epsilon of each other? Sets *samples to the number taken
+ *     and *spread to how far apart the K best were (-1 if fewer than K)
+ */
+int fcyc_converged(int *samples, double *spread)
+{
+    *samples = last_samples;
+    *spread = last_spread;
+    return last_spread >= 0 && last_spread <= epsilon;
+}
+
+/*
+ * fcyc_cache_bytes - Size of the buffer used to clear the cache
+ */
+int fcyc_cache_bytes()
+{
+    if (!cache_bytes || !cache_block)
+	find_cache();
+    return cache_bytes;
+}
+
 /*************************************************************
  * Set the various parameters used by the measurement routines 
  ************************************************************/
@@ -184,7 +273,7 @@ void set_fcyc_clear_cache(int clear)
 
 /* 
  * set_fcyc_cache_size - Set size of cache to use when clearing cache 
- *     Default = 1<<19 (512KB)
+ *     Default = size of the host's last-level cache (else 512KB)
  */
 void set_fcyc_cache_size(int bytes)
 {
@@ -199,7 +288,7 @@ void set_fcyc_cache_size(int bytes)
 
 /* 
  * set_fcyc_cache_block - Set size of cache block 
- *     Default = 32
+ *     Default = line size of the host's last-level cache (else 32)
  */
 void set_fcyc_cache_block(int bytes) {
     cache_block = bytes;
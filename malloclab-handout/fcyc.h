@@ -13,6 +13,16 @@ typedef void (*test_funct)(void *);
 /* Compute number of cycles used by test function f */
 double fcyc(test_funct f, void* argp);
 
+/* 
+ * fcyc_converged - Did the K best samples of the last fcyc call agree
+ *     within epsilon? Also returns the number of samples taken and the
+ *     spread of the K best (-1 if fewer than K were taken)
+ */
+int fcyc_converged(int *samples, double *spread);
+
+/* fcyc_cache_bytes - Size of the buffer used to clear the cache */
+int fcyc_cache_bytes(void);
+
 /*********************************************************
  * Set the various parameters used by measurement routines 
  *********************************************************/
@@ -26,13 +36,13 @@ void set_fcyc_clear_cache(int clear);
 
 /* 
  * set_fcyc_cache_size - Set size of cache to use when clearing cache 
- *     Default = 1<<19 (512KB)
+ *     Default = size of the host's last-level cache (else 1<<19, 512KB)
  */
 void set_fcyc_cache_size(int bytes);
 
 /* 
  * set_fcyc_cache_block - Set size of cache block 
- *     Default = 32
+ *     Default = line size of the host's last-level cache (else 32)
  */
 void set_fcyc_cache_block(int bytes);
 
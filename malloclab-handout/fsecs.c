@@ -30,6 +30,9 @@ void init_fsecs(void)
     set_fcyc_epsilon(0.01);
     set_fcyc_k(3);
     Mhz = mhz(verbose > 0);
+    if (verbose)
+	printf("Clearing a %d KB cache between samples.\n",
+	       fcyc_cache_bytes() >> 10);
 #elif USE_ITIMER
     if (verbose)
 	printf("Measuring performance with the interval timer.\n");
@@ -46,6 +49,18 @@ double fsecs(fsecs_test_funct f, void *argp)
 {
 #if USE_FCYC
     double cycles = fcyc(f, argp);
+    double spread;
+    int samples;
+
+    /* Report measurements the K-best scheme could not pin down */
+    if (!fcyc_converged(&samples, &spread) || verbose > 1) {
+	if (spread < 0)
+	    printf("fcyc: only %d samples taken\n", samples);
+	else
+	    printf("fcyc: K best of %d samples within %.2f%%%s\n", samples,
+		   spread * 100, fcyc_converged(&samples, &spread) ? "" :
+		   " (did not converge)");
+    }
     return cycles/(Mhz*1e6);
 #elif USE_ITIMER
     return ftimer_itimer(f, argp, 10);
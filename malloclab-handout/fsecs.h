@@ -1,4 +1,12 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 typedef void (*fsecs_test_funct)(void *);
 
 void init_fsecs(void);
 double fsecs(fsecs_test_funct f, void *argp);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,276 @@
+/*
+ * heapmap.c - Renders heap snapshots written by mdriver -s
+ *
+ * For every snapshot given on the command line, prints a summary of the
+ * heap, a fragmentation map in which each cell covers a fixed number of
+ * heap bytes, a histogram of free block sizes and the free blocks held
+ * by each box of the segregated free list. Running it on snapshots of
+ * the same trace taken with two versions of mm.c compares their layouts.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "heapsnap.h"
+
+#define NBOXES 16     /* boxes in the segregated free list */
+#define NSIZES 32     /* power-of-two size classes in the histogram */
+#define BARLEN 40     /* widest histogram bar */
+
+/* One block record from a snapshot */
+typedef struct {
+	unsigned offset;  /* offset of the block header from the heap start */
+	unsigned size;    /* block size in bytes */
+	int alloc;        /* 1 if allocated */
+	int box;          /* box of the size */
+} block_t;
+
+static int cols = 64; /* cells per map row (-w) */
+static int rows = 32; /* map rows (-r) */
+
+static void usage(void);
+
+/*
+ * get_word - Read a little-endian 32-bit word
+ */
+static unsigned get_word(FILE *fp)
+{
+	unsigned val = 0;
+	int i;
+
+	for (i = 0; i < 4; i++)
+		val |= (unsigned)(fgetc(fp) & 0xff) << (8 * i);
+	return val;
+}
+
+/*
+ * read_snapshot - Read the records of a snapshot into a new array.
+ *     Returns NULL if the file is not a valid snapshot.
+ */
+static block_t *read_snapshot(char *path, unsigned *heapsize, unsigned *n)
+{
+	FILE *fp;
+	char magic[4];
+	block_t *blocks;
+	unsigned i, word;
+	struct stat st;
+
+	if ((fp = fopen(path, "rb")) == NULL) {
+		perror(path);
+		return NULL;
+	}
+	if (fread(magic, 1, 4, fp) != 4 || memcmp(magic, HEAPSNAP_MAGIC, 4) ||
+			get_word(fp) != HEAPSNAP_VERSION) {
+		fprintf(stderr, "%s: not a version %d heap snapshot\n",
+				path, HEAPSNAP_VERSION);
+		fclose(fp);
+		return NULL;
+	}
+	*heapsize = get_word(fp);
+	*n = get_word(fp);
+	/* n comes from the file, so it must not promise more than is there */
+	if (fstat(fileno(fp), &st) < 0 || st.st_size <
+			HEAPSNAP_HDRSIZE + (off_t)*n * HEAPSNAP_RECSIZE) {
+		fprintf(stderr, "%s: snapshot is truncated\n", path);
+		fclose(fp);
+		return NULL;
+	}
+	if ((blocks = calloc((size_t)*n + 1, sizeof(block_t))) == NULL) {
+		fprintf(stderr, "%s: out of memory\n", path);
+		exit(1);
+	}
+	for (i = 0; i < *n && !feof(fp); i++) {
+		blocks[i].offset = get_word(fp);
+		word = get_word(fp);
+		blocks[i].size = word & ~0x7;
+		blocks[i].alloc = word & 0x1;
+		blocks[i].box = (signed char)fgetc(fp);
+	}
+	if (feof(fp)) {
+		fprintf(stderr, "%s: snapshot is truncated\n", path);
+		free(blocks);
+		blocks = NULL;
+	}
+	fclose(fp);
+	return blocks;
+}
+
+/*
+ * print_map - Print one character per cell: '#' if the cell is entirely
+ *     allocated, '.' if entirely free, '+' if mostly allocated and '-'
+ *     if mostly free. Bytes before the first block (the free list and
+ *     the prologue) are counted as allocated.
+ */
+static void print_map(block_t *blocks, unsigned n, unsigned heapsize)
+{
+	unsigned cellsize, ncells, i, c, lo, hi, start, end;
+	unsigned *freebytes;
+
+	ncells = cols * rows;
+	cellsize = (heapsize + ncells - 1) / ncells;
+	cellsize = (cellsize + 7) & ~0x7;
+	if (cellsize == 0)
+		cellsize = 8;
+	ncells = (heapsize + cellsize - 1) / cellsize;
+	if ((freebytes = calloc(ncells + 1, sizeof(unsigned))) == NULL) {
+		fprintf(stderr, "print_map: out of memory\n");
+		exit(1);
+	}
+
+	/* Spread the bytes of every free block over the cells it covers */
+	for (i = 0; i < n; i++) {
+		if (blocks[i].alloc)
+			continue;
+		start = blocks[i].offset;
+		end = start + blocks[i].size;
+		for (c = start / cellsize; c < ncells && c * cellsize < end; c++) {
+			lo = (c * cellsize > start) ? c * cellsize : start;
+			hi = ((c + 1) * cellsize < end) ? (c + 1) * cellsize : end;
+			freebytes[c] += hi - lo;
+		}
+	}
+
+	printf("Fragmentation map (%u bytes per cell; # allocated, . free, "
+			"+ mostly allocated, - mostly free):\n", cellsize);
+	for (c = 0; c < ncells; c++) {
+		if (c % cols == 0)
+			printf("  %08x ", c * cellsize);
+		if (freebytes[c] == 0)
+			putchar('#');
+		else if (freebytes[c] >= cellsize ||
+				(c == ncells - 1 && freebytes[c] >= heapsize - c * cellsize))
+			putchar('.');
+		else if (2 * freebytes[c] < cellsize)
+			putchar('+');
+		else
+			putchar('-');
+		if (c % cols == cols - 1 || c == ncells - 1)
+			putchar('\n');
+	}
+	free(freebytes);
+}
+
+/*
+ * print_bar - Print a histogram bar of length proportional to val/max
+ */
+static void print_bar(double val, double max)
+{
+	int i, len = (max > 0) ? (int)(BARLEN * val / max + 0.5) : 0;
+
+	for (i = 0; i < len; i++)
+		putchar('*');
+	putchar('\n');
+}
+
+/*
+ * print_snapshot - Print the summary, map and histograms for a snapshot
+ */
+static void print_snapshot(char *path, block_t *blocks, unsigned n,
+		unsigned heapsize)
+{
+	unsigned long alloc_bytes = 0, free_bytes = 0, largest = 0;
+	unsigned long size_blocks[NSIZES], size_bytes[NSIZES], max_bytes = 0;
+	unsigned long box_blocks[NBOXES], box_bytes[NBOXES];
+	unsigned i, nfree = 0;
+	int k;
+
+	memset(size_blocks, 0, sizeof(size_blocks));
+	memset(size_bytes, 0, sizeof(size_bytes));
+	memset(box_blocks, 0, sizeof(box_blocks));
+	memset(box_bytes, 0, sizeof(box_bytes));
+	for (i = 0; i < n; i++) {
+		if (blocks[i].alloc) {
+			alloc_bytes += blocks[i].size;
+			continue;
+		}
+		nfree++;
+		free_bytes += blocks[i].size;
+		if (blocks[i].size > largest)
+			largest = blocks[i].size;
+		for (k = 0; k < NSIZES - 1 && (2UL << k) <= blocks[i].size; k++)
+			;
+		size_blocks[k]++;
+		size_bytes[k] += blocks[i].size;
+		if (size_bytes[k] > max_bytes)
+			max_bytes = size_bytes[k];
+		if (blocks[i].box >= 0 && blocks[i].box < NBOXES) {
+			box_blocks[blocks[i].box]++;
+			box_bytes[blocks[i].box] += blocks[i].size;
+		}
+	}
+
+	printf("%s: heap %u bytes, %u blocks (%u allocated, %u free)\n",
+			path, heapsize, n, n - nfree, nfree);
+	printf("  allocated %lu bytes, free %lu bytes, largest free %lu, "
+			"fragmentation %.0f%%\n\n", alloc_bytes, free_bytes, largest,
+			free_bytes ? 100.0 * (1.0 - (double)largest / free_bytes) : 0.0);
+
+	print_map(blocks, n, heapsize);
+
+	printf("\nFree block sizes:\n%22s%8s%10s\n", "size", "blocks", "bytes");
+	for (k = 0; k < NSIZES; k++) {
+		if (size_blocks[k] == 0)
+			continue;
+		printf("%10lu - %-9lu%8lu%10lu  ", 1UL << k, (2UL << k) - 1,
+				size_blocks[k], size_bytes[k]);
+		print_bar(size_bytes[k], max_bytes);
+	}
+
+	printf("\nFree blocks by box:\n%5s%8s%10s\n", "box", "blocks", "bytes");
+	for (k = 0; k < NBOXES; k++)
+		printf("%5d%8lu%10lu\n", k, box_blocks[k], box_bytes[k]);
+}
+
+int main(int argc, char **argv)
+{
+	int c, i, status = 0;
+	unsigned heapsize, n;
+	block_t *blocks;
+
+	while ((c = getopt(argc, argv, "w:r:h")) != EOF) {
+		switch (c) {
+			case 'w': /* Cells per map row */
+				cols = atoi(optarg);
+				break;
+			case 'r': /* Rows in the map */
+				rows = atoi(optarg);
+				break;
+			case 'h': /* Print this message */
+				usage();
+				exit(0);
+			default:
+				usage();
+				exit(1);
+		}
+	}
+	if (optind == argc || cols <= 0 || rows <= 0) {
+		usage();
+		exit(1);
+	}
+
+	for (i = optind; i < argc; i++) {
+		if ((blocks = read_snapshot(argv[i], &heapsize, &n)) == NULL) {
+			status = 1;
+			continue;
+		}
+		if (i > optind)
+			printf("\n");
+		print_snapshot(argv[i], blocks, n, heapsize);
+		free(blocks);
+	}
+	exit(status);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+	fprintf(stderr, "Usage: heapmap [-h] [-w <cols>] [-r <rows>] <snapshot>...\n");
+	fprintf(stderr, "Options\n");
+	fprintf(stderr, "\t-h         Print this message.\n");
+	fprintf(stderr, "\t-r <rows>  Number of rows in the fragmentation map.\n");
+	fprintf(stderr, "\t-w <cols>  Number of cells in each map row.\n");
+}
@@ -0,0 +1,22 @@
+/*
+ * heapsnap.h - Binary heap snapshot format written by mm_heap_snapshot
+ *     and read by heapmap
+ *
+ * A snapshot is a header followed by one record per block, from the
+ * lowest address to the highest. All fields are little-endian.
+ *
+ *   header: magic "MMHS", u32 version, u32 heap size in bytes,
+ *           u32 number of records
+ *   record: u32 offset of the block header from mem_heap_lo(),
+ *           u32 block size with the allocated bit in bit 0,
+ *           u8  box the size maps to in the segregated free list
+ */
+#ifndef __HEAPSNAP_H_
+#define __HEAPSNAP_H_
+
+#define HEAPSNAP_MAGIC   "MMHS"
+#define HEAPSNAP_VERSION 1
+#define HEAPSNAP_HDRSIZE 16 /* bytes in the header */
+#define HEAPSNAP_RECSIZE 9  /* bytes in each block record */
+
+#endif /* __HEAPSNAP_H_ */
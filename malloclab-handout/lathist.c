@@ -0,0 +1,97 @@
+/*
+ * lathist.c - Log-linear latency histograms (see lathist.h)
+ */
+#include <string.h>
+
+#include "lathist.h"
+
+#define SUBCOUNT (1ULL << LH_SUBBITS)
+
+/*
+ * bucket_of - Index of the bucket holding v
+ */
+static int bucket_of(unsigned long long v)
+{
+	int shift;
+
+	if (v < SUBCOUNT)
+		return (int)v;
+	shift = 63 - __builtin_clzll(v) - LH_SUBBITS;
+	return ((shift + 1) << LH_SUBBITS) | (int)((v >> shift) & (SUBCOUNT - 1));
+}
+
+/*
+ * bucket_low - Smallest value in bucket b, and its width in *width
+ */
+static double bucket_low(int b, double *width)
+{
+	int shift;
+
+	if (b < (int)SUBCOUNT) {
+		*width = 1;
+		return b;
+	}
+	shift = (b >> LH_SUBBITS) - 1;
+	*width = (double)(1ULL << shift);
+	return (double)(((b & (SUBCOUNT - 1)) | SUBCOUNT) << shift);
+}
+
+/*
+ * lh_reset - Empty the histogram
+ */
+void lh_reset(lathist_t *h)
+{
+	memset(h, 0, sizeof(*h));
+}
+
+/*
+ * lh_record - Count one value
+ */
+void lh_record(lathist_t *h, unsigned long long v)
+{
+	h->buckets[bucket_of(v)]++;
+	h->count++;
+	h->sum += (double)v;
+	if (v > h->max)
+		h->max = v;
+}
+
+/*
+ * lh_merge - Add the counts of src into dst
+ */
+void lh_merge(lathist_t *dst, const lathist_t *src)
+{
+	int b;
+
+	for (b = 0; b < LH_NBUCKETS; b++)
+		dst->buckets[b] += src->buckets[b];
+	dst->count += src->count;
+	dst->sum += src->sum;
+	if (src->max > dst->max)
+		dst->max = src->max;
+}
+
+/*
+ * lh_percentile - Walk the buckets until a fraction p of the values
+ *     has been seen
+ */
+double lh_percentile(const lathist_t *h, double p)
+{
+	unsigned long long rank, seen = 0;
+	double low, width;
+	int b;
+
+	if (h->count == 0)
+		return 0;
+	if (p >= 1)
+		return (double)h->max;
+	rank = (unsigned long long)(p * h->count) + 1;
+	for (b = 0; b < LH_NBUCKETS; b++) {
+		if ((seen += h->buckets[b]) >= rank) {
+			low = bucket_low(b, &width);
+			low += (width - 1) / 2;
+			return (low > (double)h->max) ? (double)h->max : low;
+		}
+	}
+	return (double)h->max;
+}
@@ -0,0 +1,34 @@
+/*
+ * lathist.h - Log-linear latency histograms
+ *
+ * Values below 2^LH_SUBBITS each get their own bucket. Above that, every
+ * power of two is split into 2^LH_SUBBITS equal buckets, so a value is
+ * known to within about 3% whatever its magnitude, in a fixed amount of
+ * memory. Recording is a shift, a count-leading-zeros and an increment.
+ */
+#ifndef __LATHIST_H_
+#define __LATHIST_H_
+
+#define LH_SUBBITS  5
+#define LH_NBUCKETS ((64 - LH_SUBBITS + 1) << LH_SUBBITS)
+
+typedef struct {
+	unsigned long long count;    /* values recorded */
+	unsigned long long max;      /* largest value recorded */
+	double sum;                  /* sum of the values, for the mean */
+	unsigned long long buckets[LH_NBUCKETS];
+} lathist_t;
+
+void lh_reset(lathist_t *h);
+void lh_record(lathist_t *h, unsigned long long v);
+
+/* Add the counts of src into dst */
+void lh_merge(lathist_t *dst, const lathist_t *src);
+
+/*
+ * Value at or below which a fraction p of the recorded values fall,
+ * given as the middle of its bucket (the maximum for p = 1)
+ */
+double lh_percentile(const lathist_t *h, double p);
+
+#endif /* __LATHIST_H_ */
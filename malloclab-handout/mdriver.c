@@ -7,18 +7,40 @@
  * Copyright (c) 2002, R. Bryant and D. O'Hallaron, All rights reserved.
  * May not be used, modified, or copied without permission.
  */
+#define _GNU_SOURCE     /* for the CPU_* affinity macros in sched.h */
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <errno.h>
 #include <string.h>
+#include <stddef.h>
 #include <assert.h>
 #include <float.h>
+#include <math.h>
 #include <time.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <pthread.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
 
 #include "mm.h"
+#include "mmprof.h"
 #include "memlib.h"
 #include "fsecs.h"
+#include "clock.h"
+#include "lathist.h"
+#include "perfctr.h"
+#include "report.h"
+#include "bench.h"
+#include "backend.h"
+#include "cachesim.h"
+#include "tracefmt.h"
+#include "tracestream.h"
+#include "rng.h"
 #include "config.h"
 
 /**********************
@@ -29,6 +51,9 @@
 #define MAXLINE     1024 /* max string size */
 #define HDRLINES       4 /* number of header lines in a trace file */
 #define LINENUM(i) (i+5) /* cnvt trace request nums to linenums (origin 1) */
+#define RANGECHUNK  4096 /* range structs allocated at a time */
+#define MAXBACKENDS    8 /* backends loaded with -b */
+#define MAXTHREADS  1024 /* threads in one trace */
 
 /* Returns true if p is ALIGNMENT-byte aligned */
 #define IS_ALIGNED(p)  ((((unsigned int)(p)) % ALIGNMENT) == 0)
@@ -37,27 +62,42 @@
  * The key compound data types 
  *****************************/
 
-/* Records the extent of each block's payload */
+/* 
+ * Records the extent of each block's payload. The ranges form a treap:
+ * a binary search tree ordered by lo that is also a max-heap on the
+ * random prio, which keeps it balanced in expectation.
+ */
 typedef struct range_t {
 	char *lo;              /* low payload address */
 	char *hi;              /* high payload address */
-	struct range_t *next;  /* next list element */
+	unsigned prio;         /* random heap priority */
+	struct range_t *left;  /* ranges with lower addresses */
+	struct range_t *right; /* ranges with higher addresses */
 } range_t;
 
-/* Characterizes a single trace operation (allocator request) */
+/*
+ * Characterizes a single trace operation (allocator request). It is laid
+ * out like tracefmt_rec_t, so fixed-width traces are used in place.
+ */
 typedef struct {
-	enum {ALLOC, FREE, REALLOC} type; /* type of request */
+	enum {ALLOC, FREE, REALLOC} type; /* type of request (as in tracefmt.h) */
 	int index;                        /* index for free() to use later */
 	int size;                         /* byte size of alloc/realloc request */
+	int tid;                          /* thread that issues the request */
 } traceop_t;
 
+typedef char traceop_is_rec[(sizeof(traceop_t) == sizeof(tracefmt_rec_t)) ? 1 : -1];
+
 /* Holds the information for one trace file*/
 typedef struct {
 	int sugg_heapsize;   /* suggested heap size (unused) */
 	int num_ids;         /* number of alloc/realloc ids */
 	int num_ops;         /* number of distinct requests */
 	int weight;          /* weight for this trace (unused) */
+	int num_threads;     /* number of threads (1 for serial traces) */
 	traceop_t *ops;      /* array of requests */
+	void *map;           /* mapped fixed-width trace holding ops, or NULL */
+	size_t map_len;
 	char **blocks;       /* array of ptrs returned by malloc/realloc... */
 	size_t *block_sizes; /* ... and a corresponding array of payload sizes */
 } trace_t;
@@ -72,12 +112,104 @@ typedef struct {
 	range_t *ranges;
 } speed_t;
 
+/*
+ * One thread of a concurrent replay. Each thread runs its own ops in
+ * trace order; ops on the same id are ordered across threads through
+ * the per-id counters in threadrun_t.
+ */
+typedef struct {
+	int *ops;           /* indexes into trace->ops of this thread's ops */
+	int num_ops;
+	pthread_t thread;
+	struct threadrun *run;
+} tworker_t;
+
+/* Input to eval_mm_threads and eval_libc_threads, timed by fsecs */
+typedef struct threadrun {
+	trace_t *trace;
+	int use_libc;              /* replay libc malloc instead of mm.c */
+	int *op_seq;               /* position of each op among those on its id */
+	int *id_done;              /* ops done so far on each id */
+	tworker_t *workers;        /* one per thread of the trace */
+	pthread_barrier_t start;   /* releases the workers together */
+} threadrun_t;
+
+/* A live block in a streaming replay, keyed by its trace id */
+typedef struct {
+	int id;        /* trace id, or -1 if the slot is empty */
+	char *p;       /* block returned by malloc/realloc */
+	int size;      /* payload size of the request */
+} slot_t;
+
+/* Open-addressing hash table of the live blocks of a streaming replay */
+typedef struct {
+	slot_t *slots;
+	unsigned mask;  /* number of slots - 1 */
+	unsigned count; /* slots in use */
+} slotmap_t;
+
+/*
+ * Input to the xx_backend_speed functions. When touch is set (-m), the
+ * replay writes every new block and, between requests, reads a touch
+ * fraction of the live blocks, picked at random from live_ids.
+ */
+typedef struct {
+	backend_t *backend;
+	trace_t *trace;
+	double touch;              /* fraction of live blocks read, or 0 */
+	int *live_ids;             /* ids of the live blocks, in no order */
+	int *live_pos;             /* index of each id in live_ids */
+	int num_live;
+	double credit;             /* blocks owed to the next reads */
+	unsigned long long rng;    /* xorshift state, reset for each replay */
+} bspeed_t;
+
+/* Results of replaying a trace through movable handles (-H) */
+typedef struct {
+	double util;         /* peak payload over peak heap */
+	int compactions;     /* mm_compact calls */
+	size_t trimmed;      /* bytes they gave back */
+} hstats_t;
+
+/*
+ * The parts of main's result arrays that evaluating one trace fills in.
+ * A worker process (-j) sends them back to the parent in this order.
+ */
+#define MAXPARTS 24
+typedef struct {
+	int n;
+	struct {
+		void *base;
+		size_t size;
+	} part[MAXPARTS];
+} results_t;
+
+/* A worker process evaluating one trace (-j) */
+typedef struct {
+	pid_t pid;       /* 0 if the slot is free */
+	int fd;          /* read end of the pipe carrying its results */
+	int tracenum;
+	int cpu;         /* the CPU it is pinned to */
+	results_t res;   /* where its results go */
+} worker_t;
+
+/* Worker processes, one slot per CPU they may run on */
+typedef struct {
+	int n;
+	worker_t *slots;
+} workpool_t;
+
 /* Summarizes the important stats for some malloc function on some trace */
 typedef struct {
 	/* defined for both libc malloc and student malloc package (mm.c) */
 	double ops;      /* number of ops (malloc/free/realloc) in the trace */
 	int valid;       /* was the trace processed correctly by the allocator? */
 	double secs;     /* number of secs needed to run the trace */
+	double secs_sd;  /* standard deviation of secs over the runs (-R) */
+	int runs;        /* times secs was measured */
+	double secs_lo;  /* 95% confidence interval of secs (-B) */
+	double secs_hi;
+	int outliers;    /* runs rejected as outliers (-B) */
 
 	/* defined only for the student malloc package */
 	double util;     /* space utilization for this trace (always 0 for libc) */
@@ -105,14 +237,18 @@ static char *default_tracefiles[] = {
  * Function prototypes 
  *********************/
 
-/* these functions manipulate range lists */
+/* these functions manipulate the range index */
 static int add_range(range_t **ranges, char *lo, int size, 
 		int tracenum, int opnum);
+static char *index_range(range_t **ranges, char *lo, int size);
 static void remove_range(range_t **ranges, char *lo);
 static void clear_ranges(range_t **ranges);
 
 /* These functions read, allocate, and free storage for traces */
 static trace_t *read_trace(char *tracedir, char *filename);
+static void read_bintrace(trace_t *trace, char *path);
+static void alloc_trace_arrays(trace_t *trace);
+static void map_fixedtrace(trace_t *trace, char *path, void *buf, size_t len);
 static void free_trace(trace_t *trace);
 
 /* Routines for evaluating the correctness and speed of libc malloc */
@@ -122,11 +258,76 @@ static void eval_libc_speed(void *ptr);
 /* Routines for evaluating correctnes, space utilization, and speed 
    of the student's malloc package in mm.c */
 static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges);
-static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges);
+static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges,
+		mm_stats_t *heapstats, FILE *timeline, int interval);
 static void eval_mm_speed(void *ptr);
+static void setup_mm_speed(void *ptr);
+static void replay_mm_speed(void *ptr);
+
+/* Routines for evaluating the backends loaded with -b */
+static int eval_backend_valid(backend_t *b, trace_t *trace, int tracenum,
+		range_t **ranges);
+static double eval_backend_util(backend_t *b, trace_t *trace);
+static void eval_backend_speed(void *ptr);
+static void setup_backend_speed(void *ptr);
+static void replay_backend_speed(void *ptr);
+static void setup_touch(bspeed_t *sp, trace_t *trace, double touch);
+static void free_touch(bspeed_t *sp);
+static void replay_backend_touch(bspeed_t *sp);
+
+/* Routine for timing every request of the mm package */
+static void eval_mm_latency(trace_t *trace, lathist_t *lat, double overhead);
+static void eval_mm_sim(trace_t *trace, sim_stats_t *sim);
+static void eval_mm_handles(trace_t *trace, int tracenum, int interval,
+		hstats_t *hs);
+
+/* Routines for replaying each thread of a trace on its own pthread */
+static void setup_threads(trace_t *trace, threadrun_t *run);
+static void free_threads(threadrun_t *run);
+static void eval_mm_threads(void *ptr);
+static void eval_libc_threads(void *ptr);
+
+/* Routines for evaluating the mm package on traces streamed from disk */
+static void eval_mm_stream(char *tracedir, char *filename, int tracenum,
+		stats_t *stats, mm_stats_t *heapstats);
+static int stream_pass(char *path, int tracenum, int check, stats_t *stats,
+		mm_stats_t *heapstats, int *peak_op);
+
+/* Routines for evaluating traces in parallel worker processes (-j) */
+static void add_result(results_t *res, void *base, size_t size);
+static void init_workers(workpool_t *pool, int jobs);
+static pid_t start_worker(workpool_t *pool, int tracenum, results_t *res);
+static void finish_worker(results_t *res);
+static void reap_worker(workpool_t *pool);
+static void wait_workers(workpool_t *pool);
+
+/* Routines for the machine-readable results (-o) and baselines (-c) */
+static void time_runs(fsecs_test_funct f, void *argp, int runs,
+		stats_t *stats);
+static void bench_runs(bench_funct setup, bench_funct run, void *argp,
+		bench_opts_t *opts, stats_t *stats);
+static int write_report(char *path, char **tracefiles, int n,
+		stats_t *stats, mm_stats_t *heapstats, double perfindex);
+static int compare_report(char *path, char **tracefiles, int n,
+		stats_t *stats, double threshold);
 
 /* Various helper routines */
-static void printresults(int n, stats_t *stats);
+static void write_profile(char *tracefile);
+static FILE *open_timeline(char *tracefile);
+static void write_timeline(FILE *fp, int opnum, int live);
+static int find_peak(trace_t *trace);
+static void write_snapshot(trace_t *trace, char *tracefile);
+static void printresults(int n, stats_t *stats, pcvals_t *ctrs);
+static void printheapstats(int n, stats_t *stats, mm_stats_t *heapstats);
+static void printthreads(int n, int *nthreads, stats_t *mm, stats_t *libc);
+static void printlatency(int n, stats_t *stats, lathist_t *lat,
+		double overhead);
+static void printsim(int n, stats_t *stats, sim_stats_t *sim);
+static void printhandles(int n, stats_t *stats, hstats_t *hs);
+static void printcounters(int n, stats_t *stats, pcvals_t *ctrs);
+static void printbench(int n, stats_t *stats);
+static void printbackends(int n, stats_t *mm, int nbackends,
+		backend_t **backends, stats_t **bstats);
 static void usage(void);
 static void unix_error(char *msg);
 static void malloc_error(int tracenum, int opnum, char *msg);
@@ -144,21 +345,64 @@ int main(int argc, char **argv)
 	trace_t *trace = NULL;     /* stores a single trace file in memory */
 	range_t *ranges = NULL;    /* keeps track of block extents for one trace */
 	stats_t *libc_stats = NULL;/* libc stats for each trace */
-	stats_t *mm_stats = NULL;  /* mm (i.e. student) stats for each trace */
+	stats_t *mm_results = NULL;  /* mm (i.e. student) stats for each trace */
+	mm_stats_t *heapstats = NULL; /* mm allocator counters for each trace */
+	stats_t *mm_tstats = NULL;   /* mm concurrent replay stats (-T) */
+	stats_t *libc_tstats = NULL; /* libc concurrent replay stats (-T -l) */
+	int *nthreads = NULL;        /* threads in each trace (-T) */
+	lathist_t *lat = NULL;       /* latency of each request type (-L) */
+	sim_stats_t *sim = NULL;     /* simulated cache and TLB misses (-C) */
+	hstats_t *hstats = NULL;     /* replay through movable handles (-H) */
+	pcvals_t *mm_ctrs = NULL;    /* hardware counts for each trace (-P) */
+	pcvals_t *libc_ctrs = NULL;
+	double overhead = 0;         /* cost of reading the counter (-L) */
 	speed_t speed_params;      /* input parameters to the xx_speed routines */ 
+	threadrun_t run;           /* input to the xx_threads routines */
+	workpool_t pool;           /* worker processes (-j) */
+	backend_t *backends[MAXBACKENDS]; /* other allocators to compare (-b) */
+	stats_t *bstats[MAXBACKENDS];     /* their stats for each trace */
+	int nbackends = 0;
+	bspeed_t bspeed;           /* input to the xx_backend_speed routines */
+	backend_t *mm_backend = NULL, *libc_backend = NULL; /* for -m */
+	double touch = 0;          /* fraction of live blocks read (-m) */
+	void (*speed_fn)(void *), (*setup_fn)(void *), (*replay_fn)(void *);
+	void *speed_arg;           /* input to the speed_fn routines */
+	const char *err;
+	int b;
+	results_t res;             /* results of the trace a worker evaluates */
 
 	int team_check = 1;  /* If set, check team structure (reset by -a) */
 	int run_libc = 0;    /* If set, run libc malloc (set by -l) */
 	int autograder = 0;  /* If set, emit summary info for autograder (-g) */
+	size_t prof_interval = 0; /* If set, profile the util pass (-p) */
+	int util_interval = 0; /* If set, sample the util pass every n ops (-u) */
+	FILE *timeline = NULL;
+	int snapshot = 0;    /* If set, save the heap at its peak (-s) */
+	int stream = 0;      /* If set, stream traces from disk (-S) */
+	int threads = 0;     /* If set, also replay threads concurrently (-T) */
+	int latency = 0;     /* If set, time every request (-L) */
+	int simulate = 0;    /* If set, run the cache and TLB model (-C) */
+	int compact_interval = 0; /* If set, compact every n requests (-H) */
+	int counters = 0;    /* If set, read the hardware counters (-P) */
+	int jobs = 1;        /* Traces evaluated at once (-j) */
+	int runs = 1;        /* Times each trace is timed (-R) */
+	int benchmark = 0;   /* If set, time until the median is known (-B) */
+	bench_opts_t bopts;  /* warm-up and precision of -B */
+	char *outfile = NULL;  /* Machine-readable results (-o) */
+	char *basefile = NULL; /* Baseline to compare with (-c) */
+	double threshold = 0.05; /* Throughput drop that is a regression (-x) */
+	int regressions = 0;
 
 	/* temporaries used to compute the performance index */
 	double secs, ops, util, avg_mm_util, avg_mm_throughput, p1, p2, perfindex;
 	int numcorrect;
 
+	bench_defaults(&bopts);
+
 	/* 
 	 * Read and interpret the command line arguments 
 	 */
-	while ((c = getopt(argc, argv, "f:t:hvVgal")) != EOF) {
+	while ((c = getopt(argc, argv, "f:t:p:u:j:o:c:x:R:w:e:b:m:C:H:BsSTLPhvVgal")) != EOF) {
 		switch (c) {
 			case 'g': /* Generate summary info for the autograder */
 				autograder = 1;
@@ -184,6 +428,93 @@ int main(int argc, char **argv)
 			case 'l': /* Run libc malloc */
 				run_libc = 1;
 				break;
+			case 'p': /* Sample the heap every <bytes> during the util pass */
+				prof_interval = strtoul(optarg, NULL, 0);
+				break;
+			case 'u': /* Write a utilization timeline of the util pass */
+				if ((util_interval = atoi(optarg)) < 1) {
+					usage();
+					exit(1);
+				}
+				break;
+			case 's': /* Save a snapshot of the heap at its peak */
+				snapshot = 1;
+				break;
+			case 'S': /* Stream traces that do not fit in memory */
+				stream = 1;
+				break;
+			case 'T': /* Replay the threads of each trace concurrently */
+				threads = 1;
+				break;
+			case 'C': /* Simulate the caches and TLB, with this model */
+				if (sim_config(optarg) < 0) {
+					sprintf(msg, "ERROR: bad cache model %s", optarg);
+					app_error(msg);
+				}
+				simulate = 1;
+				break;
+			case 'H': /* Replay through handles, compacting every n requests */
+				if ((compact_interval = atoi(optarg)) <= 0) {
+					usage();
+					exit(1);
+				}
+				break;
+			case 'L': /* Histogram the latency of every request */
+				latency = 1;
+				break;
+			case 'j': /* Evaluate traces in parallel worker processes */
+				jobs = atoi(optarg);
+				if (jobs < 1) {
+					usage();
+					exit(1);
+				}
+				break;
+			case 'o': /* Write the results as CSV or JSON */
+				outfile = optarg;
+				break;
+			case 'c': /* Compare the results with a baseline */
+				basefile = optarg;
+				break;
+			case 'x': /* Regression threshold in percent */
+				threshold = atof(optarg) / 100;
+				break;
+			case 'R': /* Time each trace this many times */
+				if ((runs = atoi(optarg)) < 1) {
+					usage();
+					exit(1);
+				}
+				break;
+			case 'b': /* Compare with another allocator */
+				if (nbackends == MAXBACKENDS)
+					app_error("ERROR: too many backends (-b)");
+				if ((backends[nbackends] = backend_open(optarg, &err)) == NULL) {
+					sprintf(msg, "ERROR: could not load backend %s: %s",
+							optarg, err);
+					app_error(msg);
+				}
+				nbackends++;
+				break;
+			case 'm': /* Touch the payloads, reading <pct> of the live blocks */
+				touch = atof(optarg) / 100;
+				if (touch <= 0 || touch > 1) {
+					usage();
+					exit(1);
+				}
+				break;
+			case 'B': /* Benchmark: time each trace to a confidence interval */
+				benchmark = 1;
+				break;
+			case 'w': /* Untimed warm-up runs of -B */
+				bopts.warmup = atoi(optarg);
+				break;
+			case 'e': /* Half-width of the -B confidence interval, in percent */
+				bopts.rel_ci = atof(optarg) / 100;
+				break;
+			case 'P': /* Count hardware events while replaying (implies -v) */
+				counters = 1;
+				if (!verbose)
+					verbose = 1;
+				break;
 			case 'v': /* Print per-trace performance breakdown */
 				verbose = 1;
 				break;
@@ -237,11 +568,33 @@ int main(int argc, char **argv)
 
 	/* Initialize the timing package */
 	init_fsecs();
+	if (stream)
+		jobs = 1;
+	if (jobs > 1)
+		init_workers(&pool, jobs);
+	memset(&bspeed, 0, sizeof(bspeed));
+	if (touch > 0) {
+		/* the touching replay goes through the backend table */
+		mm_backend = backend_open("mm", &err);
+		libc_backend = backend_open("libc", &err);
+	}
+	if (counters && !stream) {
+		if (pc_init() == 0) {
+			printf("Hardware counters are not available; ignoring -P\n");
+			counters = 0;
+		}
+		else {
+			mm_ctrs = (pcvals_t *)calloc(num_tracefiles, sizeof(pcvals_t));
+			libc_ctrs = (pcvals_t *)calloc(num_tracefiles, sizeof(pcvals_t));
+			if (mm_ctrs == NULL || libc_ctrs == NULL)
+				unix_error("counter calloc in main failed");
+		}
+	}
 
 	/*
 	 * Optionally run and evaluate the libc malloc package 
 	 */
-	if (run_libc) {
+	if (run_libc && !stream) {
 		if (verbose > 1)
 			printf("\nTesting libc malloc\n");
 
@@ -252,6 +605,14 @@ int main(int argc, char **argv)
 
 		/* Evaluate the libc malloc package using the K-best scheme */
 		for (i=0; i < num_tracefiles; i++) {
+			if (jobs > 1) {
+				res.n = 0;
+				add_result(&res, &libc_stats[i], sizeof(stats_t));
+				add_result(&res, libc_ctrs ? &libc_ctrs[i] : NULL,
+						sizeof(pcvals_t));
+				if (start_worker(&pool, i, &res) != 0)
+					continue;
+			}
 			trace = read_trace(tracedir, tracefiles[i]);
 			libc_stats[i].ops = trace->num_ops;
 			if (verbose > 1)
@@ -259,17 +620,46 @@ int main(int argc, char **argv)
 			libc_stats[i].valid = eval_libc_valid(trace, i);
 			if (libc_stats[i].valid) {
 				speed_params.trace = trace;
+				speed_fn = replay_fn = eval_libc_speed;
+				setup_fn = NULL;
+				speed_arg = &speed_params;
+				if (touch > 0) {
+					setup_touch(&bspeed, trace, touch);
+					bspeed.backend = libc_backend;
+					speed_fn = eval_backend_speed;
+					setup_fn = setup_backend_speed;
+					replay_fn = replay_backend_speed;
+					speed_arg = &bspeed;
+				}
 				if (verbose > 1)
 					printf("and performance.\n");
-				libc_stats[i].secs = fsecs(eval_libc_speed, &speed_params);
+				if (benchmark)
+					bench_runs(setup_fn, replay_fn, speed_arg, &bopts,
+							&libc_stats[i]);
+				else
+					time_runs(speed_fn, speed_arg, runs, &libc_stats[i]);
+				if (counters) {
+					pc_start();
+					speed_fn(speed_arg);
+					pc_stop(&libc_ctrs[i]);
+				}
 			}
+			free_touch(&bspeed);
 			free_trace(trace);
+			if (jobs > 1)
+				finish_worker(&res);
 		}
+		if (jobs > 1)
+			wait_workers(&pool);
 
 		/* Display the libc results in a compact table */
 		if (verbose) {
 			printf("\nResults for libc malloc:\n");
-			printresults(num_tracefiles, libc_stats);
+			printresults(num_tracefiles, libc_stats, libc_ctrs);
+		}
+		if (benchmark) {
+			printf("\nBenchmark of libc malloc:\n");
+			printbench(num_tracefiles, libc_stats);
 		}
 	}
 
@@ -280,37 +670,201 @@ int main(int argc, char **argv)
 		printf("\nTesting mm malloc\n");
 
 	/* Allocate the mm stats array, with one stats_t struct per tracefile */
-	mm_stats = (stats_t *)calloc(num_tracefiles, sizeof(stats_t));
-	if (mm_stats == NULL)
-		unix_error("mm_stats calloc in main failed");
+	mm_results = (stats_t *)calloc(num_tracefiles, sizeof(stats_t));
+	if (mm_results == NULL)
+		unix_error("mm_results calloc in main failed");
+	heapstats = (mm_stats_t *)calloc(num_tracefiles, sizeof(mm_stats_t));
+	if (heapstats == NULL)
+		unix_error("heapstats calloc in main failed");
+	if (threads) {
+		mm_tstats = (stats_t *)calloc(num_tracefiles, sizeof(stats_t));
+		libc_tstats = (stats_t *)calloc(num_tracefiles, sizeof(stats_t));
+		nthreads = (int *)calloc(num_tracefiles, sizeof(int));
+		if (mm_tstats == NULL || libc_tstats == NULL || nthreads == NULL)
+			unix_error("thread stats calloc in main failed");
+	}
+	for (b = 0; b < nbackends; b++)
+		if ((bstats[b] = (stats_t *)calloc(num_tracefiles, sizeof(stats_t))) == NULL)
+			unix_error("backend stats calloc in main failed");
+	if (latency) {
+		/* one histogram per request type (ALLOC, FREE, REALLOC) */
+		lat = (lathist_t *)calloc(3 * num_tracefiles, sizeof(lathist_t));
+		if (lat == NULL)
+			unix_error("latency calloc in main failed");
+		overhead = counter_overhead();
+	}
+	if (simulate && !stream) {
+		sim = (sim_stats_t *)calloc(num_tracefiles, sizeof(sim_stats_t));
+		if (sim == NULL)
+			unix_error("sim calloc in main failed");
+	}
+	if (compact_interval && !stream) {
+		hstats = (hstats_t *)calloc(num_tracefiles, sizeof(hstats_t));
+		if (hstats == NULL)
+			unix_error("handle stats calloc in main failed");
+	}
 
 	/* Initialize the simulated memory system in memlib.c */
 	mem_init(); 
 
 	/* Evaluate student's mm malloc package using the K-best scheme */
 	for (i=0; i < num_tracefiles; i++) {
+		if (stream) {
+			eval_mm_stream(tracedir, tracefiles[i], i, &mm_results[i],
+					&heapstats[i]);
+			continue;
+		}
+		if (jobs > 1) {
+			res.n = 0;
+			add_result(&res, &mm_results[i], sizeof(stats_t));
+			add_result(&res, &heapstats[i], sizeof(mm_stats_t));
+			add_result(&res, lat ? &lat[3 * i] : NULL, 3 * sizeof(lathist_t));
+			add_result(&res, sim ? &sim[i] : NULL, sizeof(sim_stats_t));
+			add_result(&res, hstats ? &hstats[i] : NULL, sizeof(hstats_t));
+			add_result(&res, mm_ctrs ? &mm_ctrs[i] : NULL, sizeof(pcvals_t));
+			add_result(&res, mm_tstats ? &mm_tstats[i] : NULL, sizeof(stats_t));
+			add_result(&res, libc_tstats ? &libc_tstats[i] : NULL,
+					sizeof(stats_t));
+			add_result(&res, nthreads ? &nthreads[i] : NULL, sizeof(int));
+			for (b = 0; b < nbackends; b++)
+				add_result(&res, &bstats[b][i], sizeof(stats_t));
+			if (start_worker(&pool, i, &res) != 0)
+				continue;
+		}
 		trace = read_trace(tracedir, tracefiles[i]);
-		mm_stats[i].ops = trace->num_ops;
+		mm_results[i].ops = trace->num_ops;
 		if (verbose > 1)
 			printf("Checking mm_malloc for correctness, ");
-		mm_stats[i].valid = eval_mm_valid(trace, i, &ranges);
-		if (mm_stats[i].valid) {
+		mm_results[i].valid = eval_mm_valid(trace, i, &ranges);
+		if (mm_results[i].valid) {
 			if (verbose > 1)
 				printf("efficiency, ");
-			mm_stats[i].util = eval_mm_util(trace, i, &ranges);
+			mm_prof_set_interval(prof_interval);
+			if (util_interval)
+				timeline = open_timeline(tracefiles[i]);
+			mm_results[i].util = eval_mm_util(trace, i, &ranges, &heapstats[i],
+					timeline, util_interval);
+			if (timeline != NULL) {
+				fclose(timeline);
+				timeline = NULL;
+			}
+			if (prof_interval) {
+				write_profile(tracefiles[i]);
+				mm_prof_set_interval(0);
+			}
+			if (snapshot)
+				write_snapshot(trace, tracefiles[i]);
 			speed_params.trace = trace;
 			speed_params.ranges = ranges;
+			speed_fn = eval_mm_speed;
+			setup_fn = setup_mm_speed;
+			replay_fn = replay_mm_speed;
+			speed_arg = &speed_params;
+			if (touch > 0) {
+				setup_touch(&bspeed, trace, touch);
+				bspeed.backend = mm_backend;
+				speed_fn = eval_backend_speed;
+				setup_fn = setup_backend_speed;
+				replay_fn = replay_backend_speed;
+				speed_arg = &bspeed;
+			}
 			if (verbose > 1)
 				printf("and performance.\n");
-			mm_stats[i].secs = fsecs(eval_mm_speed, &speed_params);
+			if (benchmark)
+				bench_runs(setup_fn, replay_fn, speed_arg, &bopts,
+						&mm_results[i]);
+			else
+				time_runs(speed_fn, speed_arg, runs, &mm_results[i]);
+			if (counters) {
+				pc_start();
+				speed_fn(speed_arg);
+				pc_stop(&mm_ctrs[i]);
+			}
+			if (latency)
+				eval_mm_latency(trace, &lat[3 * i], overhead);
+			if (sim != NULL)
+				eval_mm_sim(trace, &sim[i]);
+			if (hstats != NULL)
+				eval_mm_handles(trace, i, compact_interval, &hstats[i]);
+
+			if (threads) {
+				if (verbose > 1)
+					printf("Replaying %d threads concurrently.\n",
+							trace->num_threads);
+				nthreads[i] = trace->num_threads;
+				setup_threads(trace, &run);
+				mm_tstats[i].ops = libc_tstats[i].ops = trace->num_ops;
+				mm_tstats[i].valid = 1;
+				mm_tstats[i].secs = fsecs(eval_mm_threads, &run);
+				if (run_libc) {
+					libc_tstats[i].valid = 1;
+					libc_tstats[i].secs = fsecs(eval_libc_threads, &run);
+				}
+				free_threads(&run);
+			}
+		}
+
+		/* Replay the trace against each of the other backends */
+		for (b = 0; b < nbackends; b++) {
+			if (verbose > 1)
+				printf("Checking backend %s for correctness, efficiency and "
+						"performance.\n", backends[b]->name);
+			bstats[b][i].ops = trace->num_ops;
+			bstats[b][i].valid = eval_backend_valid(backends[b], trace, i,
+					&ranges);
+			if (!bstats[b][i].valid)
+				continue;
+			bstats[b][i].util = eval_backend_util(backends[b], trace);
+			if (touch > 0)
+				setup_touch(&bspeed, trace, touch);
+			bspeed.backend = backends[b];
+			bspeed.trace = trace;
+			if (benchmark)
+				bench_runs(setup_backend_speed, replay_backend_speed, &bspeed,
+						&bopts, &bstats[b][i]);
+			else
+				time_runs(eval_backend_speed, &bspeed, runs, &bstats[b][i]);
 		}
+		free_touch(&bspeed);
 		free_trace(trace);
+		if (jobs > 1)
+			finish_worker(&res);
 	}
+	if (jobs > 1)
+		wait_workers(&pool);
 
 	/* Display the mm results in a compact table */
 	if (verbose) {
 		printf("\nResults for mm malloc:\n");
-		printresults(num_tracefiles, mm_stats);
+		printresults(num_tracefiles, mm_results, mm_ctrs);
+		printf("\n");
+		printheapstats(num_tracefiles, mm_results, heapstats);
+		printf("\n");
+	}
+	if (nbackends > 0 && !stream) {
+		printbackends(num_tracefiles, mm_results, nbackends, backends, bstats);
+		printf("\n");
+	}
+	if (benchmark && !stream) {
+		printf("Benchmark of mm malloc:\n");
+		printbench(num_tracefiles, mm_results);
+		printf("\n");
+	}
+	if (latency && !stream) {
+		printlatency(num_tracefiles, mm_results, lat, overhead);
+		printf("\n");
+	}
+	if (sim != NULL) {
+		printsim(num_tracefiles, mm_results, sim);
+		printf("\n");
+	}
+	if (hstats != NULL) {
+		printhandles(num_tracefiles, mm_results, hstats);
+		printf("\n");
+	}
+	if (threads && !stream) {
+		printthreads(num_tracefiles, nthreads, mm_tstats,
+				run_libc ? libc_tstats : NULL);
 		printf("\n");
 	}
 
@@ -322,10 +876,10 @@ int main(int argc, char **argv)
 	util = 0;
 	numcorrect = 0;
 	for (i=0; i < num_tracefiles; i++) {
-		secs += mm_stats[i].secs;
-		ops += mm_stats[i].ops;
-		util += mm_stats[i].util;
-		if (mm_stats[i].valid)
+		secs += mm_results[i].secs;
+		ops += mm_results[i].ops;
+		util += mm_results[i].util;
+		if (mm_results[i].valid)
 			numcorrect++;
 	}
 	avg_mm_util = util/num_tracefiles;
@@ -362,39 +916,135 @@ int main(int argc, char **argv)
 		printf("perfidx:%.0f\n", perfindex);
 	}
 
-	exit(0);
+	/* 
+	 * Save the results, and gate them on the baseline
+	 */
+	if (outfile != NULL && write_report(outfile, tracefiles, num_tracefiles,
+				mm_results, heapstats, errors ? -1 : perfindex) < 0)
+		unix_error("ERROR: could not write the results");
+	if (basefile != NULL) {
+		printf("\n");
+		regressions = compare_report(basefile, tracefiles, num_tracefiles,
+				mm_results, threshold);
+		if (regressions > 0)
+			printf("%d regressions against %s\n", regressions, basefile);
+	}
+
+	exit(regressions > 0 ? 2 : 0);
 }
 
 
 /*****************************************************************
- * The following routines manipulate the range list, which keeps 
+ * The following routines manipulate the range index, which keeps 
  * track of the extent of every allocated block payload. We use the 
- * range list to detect any overlapping allocated blocks.
+ * range index to detect any overlapping allocated blocks.
  ****************************************************************/
 
+/* Unused range structs, linked through their right pointers */
+static range_t *range_pool = NULL;
+static unsigned range_seed = 2463534242u;
+
+/*
+ * new_range - take a range struct from the pool, refilling the pool
+ *     with RANGECHUNK structs at a time when it runs dry
+ */
+static range_t *new_range(char *lo, char *hi)
+{
+	range_t *p;
+	int i;
+
+	if (range_pool == NULL) {
+		if ((p = (range_t *)malloc(RANGECHUNK * sizeof(range_t))) == NULL)
+			unix_error("malloc error in new_range");
+		for (i = 0; i < RANGECHUNK; i++) {
+			p[i].right = range_pool;
+			range_pool = &p[i];
+		}
+	}
+	p = range_pool;
+	range_pool = p->right;
+
+	/* xorshift32 priorities; only their relative order matters */
+	range_seed ^= range_seed << 13;
+	range_seed ^= range_seed >> 17;
+	range_seed ^= range_seed << 5;
+	p->prio = range_seed;
+	p->lo = lo;
+	p->hi = hi;
+	p->left = p->right = NULL;
+	return p;
+}
+
+/*
+ * put_range - return a range struct to the pool
+ */
+static void put_range(range_t *p)
+{
+	p->right = range_pool;
+	range_pool = p;
+}
+
+/*
+ * insert_range - insert p into the treap rooted at t, return the new root
+ */
+static range_t *insert_range(range_t *t, range_t *p)
+{
+	range_t *child;
+
+	if (t == NULL)
+		return p;
+	if (p->lo < t->lo) {
+		child = t->left = insert_range(t->left, p);
+		if (child->prio > t->prio) {   /* rotate right */
+			t->left = child->right;
+			child->right = t;
+			return child;
+		}
+	}
+	else {
+		child = t->right = insert_range(t->right, p);
+		if (child->prio > t->prio) {   /* rotate left */
+			t->right = child->left;
+			child->left = t;
+			return child;
+		}
+	}
+	return t;
+}
+
+/*
+ * join_ranges - merge two treaps where every range in a lies below
+ *     every range in b, return the new root
+ */
+static range_t *join_ranges(range_t *a, range_t *b)
+{
+	if (a == NULL)
+		return b;
+	if (b == NULL)
+		return a;
+	if (a->prio > b->prio) {
+		a->right = join_ranges(a->right, b);
+		return a;
+	}
+	b->left = join_ranges(a, b->left);
+	return b;
+}
+
 /*
  * add_range - As directed by request opnum in trace tracenum,
  *     we've just called the student's mm_malloc to allocate a block of 
  *     size bytes at addr lo. After checking the block for correctness,
- *     we create a range struct for this block and add it to the range list. 
+ *     we create a range struct for this block and add it to the range index. 
  */
 static int add_range(range_t **ranges, char *lo, int size, 
 		int tracenum, int opnum)
 {
 	char *hi = lo + size - 1;
-	range_t *p;
+	char *err;
 	char msg[MAXLINE];
 
 	assert(size > 0);
 
-	/* Payload addresses must be ALIGNMENT-byte aligned */
-	if (!IS_ALIGNED(lo)) {
-		sprintf(msg, "Payload address (%p) not aligned to %d bytes", 
-				lo, ALIGNMENT);
-		malloc_error(tracenum, opnum, msg);
-		return 0;
-	}
-
 	/* The payload must lie within the extent of the heap */
 	if ((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) || 
 			(hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi())) {
@@ -404,28 +1054,58 @@ static int add_range(range_t **ranges, char *lo, int size,
 		return 0;
 	}
 
-	/* The payload must not overlap any other payloads */
-	for (p = *ranges;  p != NULL;  p = p->next) {
-		if ((lo >= p->lo && lo <= p-> hi) ||
-				(hi >= p->lo && hi <= p->hi)) {
-			sprintf(msg, "Payload (%p:%p) overlaps another payload (%p:%p)\n",
-					lo, hi, p->lo, p->hi);
-			malloc_error(tracenum, opnum, msg);
-			return 0;
+	if ((err = index_range(ranges, lo, size)) != NULL) {
+		malloc_error(tracenum, opnum, err);
+		return 0;
+	}
+	return 1;
+}
+
+/*
+ * index_range - Check that a payload of size bytes at lo is aligned and
+ *     overlaps no other payload, and add it to the range index. Returns
+ *     NULL if it is, and what is wrong with it otherwise; add_range also
+ *     checks it is inside the heap, which other backends do not have.
+ */
+static char *index_range(range_t **ranges, char *lo, int size)
+{
+	char *hi = lo + size - 1;
+	range_t *p, *floor;
+	static char msg[MAXLINE];
+
+	/* Payload addresses must be ALIGNMENT-byte aligned */
+	if (!IS_ALIGNED(lo)) {
+		sprintf(msg, "Payload address (%p) not aligned to %d bytes", 
+				lo, ALIGNMENT);
+		return msg;
+	}
+
+	/* 
+	 * The payload must not overlap any other payloads. The ranges in
+	 * the index are disjoint, so only the one with the highest lo not
+	 * above our hi can overlap us.
+	 */
+	floor = NULL;
+	for (p = *ranges;  p != NULL; ) {
+		if (p->lo <= hi) {
+			floor = p;
+			p = p->right;
 		}
+		else
+			p = p->left;
+	}
+	if (floor != NULL && floor->hi >= lo) {
+		sprintf(msg, "Payload (%p:%p) overlaps another payload (%p:%p)\n",
+				lo, hi, floor->lo, floor->hi);
+		return msg;
 	}
 
 	/* 
 	 * Everything looks OK, so remember the extent of this block 
-	 * by creating a range struct and adding it the range list.
+	 * by creating a range struct and adding it the range index.
 	 */
-	if ((p = (range_t *)malloc(sizeof(range_t))) == NULL)
-		unix_error("malloc error in add_range");
-	p->next = *ranges;
-	p->lo = lo;
-	p->hi = hi;
-	*ranges = p;
-	return 1;
+	*ranges = insert_range(*ranges, new_range(lo, hi));
+	return NULL;
 }
 
 /* 
@@ -435,16 +1115,14 @@ static void remove_range(range_t **ranges, char *lo)
 {
 	range_t *p;
 	range_t **prevpp = ranges;
-	int size;
 
-	for (p = *ranges;  p != NULL; p = p->next) {
-		if (p->lo == lo) {
-			*prevpp = p->next;
-			size = p->hi - p->lo + 1;
-			free(p);
-			break;
-		}
-		prevpp = &(p->next);
+	for (p = *ranges;  p != NULL && p->lo != lo; ) {
+		prevpp = (lo < p->lo) ? &(p->left) : &(p->right);
+		p = *prevpp;
+	}
+	if (p != NULL) {
+		*prevpp = join_ranges(p->left, p->right);
+		put_range(p);
 	}
 }
 
@@ -453,13 +1131,13 @@ static void remove_range(range_t **ranges, char *lo)
  */
 static void clear_ranges(range_t **ranges)
 {
-	range_t *p;
-	range_t *pnext;
+	range_t *p = *ranges;
 
-	for (p = *ranges;  p != NULL;  p = pnext) {
-		pnext = p->next;
-		free(p);
-	}
+	if (p == NULL)
+		return;
+	clear_ranges(&(p->left));
+	clear_ranges(&(p->right));
+	put_range(p);
 	*ranges = NULL;
 }
 
@@ -477,9 +1155,11 @@ static trace_t *read_trace(char *tracedir, char *filename)
 	trace_t *trace;
 	char type[MAXLINE];
 	char path[MAXLINE];
+	char magic[5];
 	unsigned index, size;
 	unsigned max_index = 0;
 	unsigned op_index;
+	int tid = 0;
 
 	if (verbose > 1)
 		printf("Reading tracefile: %s\n", filename);
@@ -487,6 +1167,8 @@ static trace_t *read_trace(char *tracedir, char *filename)
 	/* Allocate the trace record */
 	if ((trace = (trace_t *) malloc(sizeof(trace_t))) == NULL)
 		unix_error("malloc 1 failed in read_trance");
+	trace->ops = NULL;
+	trace->map = NULL;
 
 	/* Read the trace file header */
 	strcpy(path, tracedir);
@@ -495,25 +1177,22 @@ static trace_t *read_trace(char *tracedir, char *filename)
 		sprintf(msg, "Could not open %s in read_trace", path);
 		unix_error(msg);
 	}
+
+	/* Binary traces (see tracefmt.h) are decoded straight from memory */
+	if (fread(magic, 1, sizeof(magic), tracefile) == sizeof(magic) &&
+			tracefmt_is_binary(magic, sizeof(magic))) {
+		fclose(tracefile);
+		read_bintrace(trace, path);
+		return trace;
+	}
+	rewind(tracefile);
+
 	fscanf(tracefile, "%d", &(trace->sugg_heapsize)); /* not used */
 	fscanf(tracefile, "%d", &(trace->num_ids));     
 	fscanf(tracefile, "%d", &(trace->num_ops));     
 	fscanf(tracefile, "%d", &(trace->weight));        /* not used */
-
-	/* We'll store each request line in the trace in this array */
-	if ((trace->ops = 
-				(traceop_t *)malloc(trace->num_ops * sizeof(traceop_t))) == NULL)
-		unix_error("malloc 2 failed in read_trace");
-
-	/* We'll keep an array of pointers to the allocated blocks here... */
-	if ((trace->blocks = 
-				(char **)malloc(trace->num_ids * sizeof(char *))) == NULL)
-		unix_error("malloc 3 failed in read_trace");
-
-	/* ... along with the corresponding byte sizes of each block */
-	if ((trace->block_sizes = 
-				(size_t *)malloc(trace->num_ids * sizeof(size_t))) == NULL)
-		unix_error("malloc 4 failed in read_trace");
+	trace->num_threads = 1;
+	alloc_trace_arrays(trace);
 
 	/* read every request line in the trace file */
 	index = 0;
@@ -539,11 +1218,22 @@ static trace_t *read_trace(char *tracedir, char *filename)
 				trace->ops[op_index].type = FREE;
 				trace->ops[op_index].index = index;
 				break;
+			case 't': /* the following ops are issued by another thread */
+				if (fscanf(tracefile, "%d", &tid) != 1 || tid < 0 ||
+						tid >= MAXTHREADS) {
+					printf("Bad thread switch after request %u in tracefile %s\n",
+							op_index, path);
+					exit(1);
+				}
+				if (tid >= trace->num_threads)
+					trace->num_threads = tid + 1;
+				continue;
 			default:
 				printf("Bogus type character (%c) in tracefile %s\n", 
 						type[0], path);
 				exit(1);
 		}
+		trace->ops[op_index].tid = tid;
 		op_index++;
 
 	}
@@ -554,13 +1244,137 @@ static trace_t *read_trace(char *tracedir, char *filename)
 	return trace;
 }
 
+/*
+ * alloc_trace_arrays - allocate the op, block and size arrays of a
+ *     trace whose header fields have been read; ops that are already
+ *     mapped are left there
+ */
+static void alloc_trace_arrays(trace_t *trace)
+{
+	/* We'll store each request line in the trace in this array */
+	if (trace->ops == NULL && (trace->ops = 
+				(traceop_t *)malloc(trace->num_ops * sizeof(traceop_t))) == NULL)
+		unix_error("malloc 2 failed in read_trace");
+
+	/* We'll keep an array of pointers to the allocated blocks here... */
+	if ((trace->blocks = 
+				(char **)malloc(trace->num_ids * sizeof(char *))) == NULL)
+		unix_error("malloc 3 failed in read_trace");
+
+	/* ... along with the corresponding byte sizes of each block */
+	if ((trace->block_sizes = 
+				(size_t *)malloc(trace->num_ids * sizeof(size_t))) == NULL)
+		unix_error("malloc 4 failed in read_trace");
+}
+
+/*
+ * read_bintrace - map a binary trace into memory. The ops of the compact
+ *     layout are decoded into trace->ops in one pass, without any of the
+ *     text parsing of read_trace; those of the fixed-width layout are
+ *     replayed from the mapping, after one pass that only checks them.
+ */
+static void read_bintrace(trace_t *trace, char *path)
+{
+	int fd, op_index, type, index, size, rc, tid = 0;
+	struct stat st;
+	void *buf;
+	tracefmt_hdr_t hdr;
+	tracefmt_cursor_t cur;
+
+	if ((fd = open(path, O_RDONLY)) < 0 || fstat(fd, &st) < 0)
+		unix_error(path);
+	buf = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (buf == MAP_FAILED)
+		unix_error("mmap failed in read_bintrace");
+	close(fd);
+	if (st.st_size > 4 && ((unsigned char *)buf)[4] == TRACEFMT_FIXED) {
+		map_fixedtrace(trace, path, buf, st.st_size);
+		return;
+	}
+	madvise(buf, st.st_size, MADV_SEQUENTIAL);
+
+	if (tracefmt_open(&cur, buf, st.st_size, &hdr) < 0) {
+		sprintf(msg, "Bad binary trace header in %s", path);
+		app_error(msg);
+	}
+	trace->sugg_heapsize = hdr.sugg_heapsize;
+	trace->num_ids = hdr.num_ids;
+	trace->num_ops = hdr.num_ops;
+	trace->weight = hdr.weight;
+	trace->num_threads = 1;
+	alloc_trace_arrays(trace);
+
+	op_index = 0;
+	while ((rc = tracefmt_next(&cur, &type, &index, &size)) > 0) {
+		if (type == TRACEFMT_THREAD) {
+			if (index < 0 || index >= MAXTHREADS)
+				break;
+			if ((tid = index) >= trace->num_threads)
+				trace->num_threads = tid + 1;
+			continue;
+		}
+		if (op_index >= trace->num_ops || index < 0 ||
+				index >= trace->num_ids || size < 0)
+			break;
+		trace->ops[op_index].type = type;
+		trace->ops[op_index].index = index;
+		trace->ops[op_index].size = size;
+		trace->ops[op_index].tid = tid;
+		op_index++;
+	}
+	if (rc != 0 || op_index != trace->num_ops) {
+		sprintf(msg, "Malformed binary trace %s (op %d)", path, op_index);
+		app_error(msg);
+	}
+	munmap(buf, st.st_size);
+}
+
+/*
+ * map_fixedtrace - use the records of a mapped fixed-width trace as its
+ *     ops. Nothing is decoded, but every record is checked once so that
+ *     replay can index blocks with it.
+ */
+static void map_fixedtrace(trace_t *trace, char *path, void *buf, size_t len)
+{
+	const tracefmt_rec_t *recs;
+	tracefmt_hdr_t hdr;
+	int i;
+
+	if ((recs = tracefmt_open_fixed(buf, len, &hdr, &trace->num_threads))
+			== NULL || trace->num_threads > MAXTHREADS) {
+		sprintf(msg, "Bad fixed-width trace header in %s", path);
+		app_error(msg);
+	}
+	trace->sugg_heapsize = hdr.sugg_heapsize;
+	trace->num_ids = hdr.num_ids;
+	trace->num_ops = hdr.num_ops;
+	trace->weight = hdr.weight;
+	for (i = 0; i < trace->num_ops; i++) {
+		if (recs[i].type < TRACEFMT_ALLOC || recs[i].type > TRACEFMT_REALLOC ||
+				recs[i].id < 0 || recs[i].id >= trace->num_ids ||
+				recs[i].size < 0 || recs[i].tid < 0 ||
+				recs[i].tid >= trace->num_threads) {
+			sprintf(msg, "Malformed fixed-width trace %s (op %d)", path, i);
+			app_error(msg);
+		}
+	}
+	trace->ops = (traceop_t *)recs;
+	trace->map = buf;
+	trace->map_len = len;
+	alloc_trace_arrays(trace);
+}
+
 /*
  * free_trace - Free the trace record and the three arrays it points
- *              to, all of which were allocated in read_trace().
+ *              to, all of which were allocated in read_trace(), or
+ *              unmap the trace that holds the ops.
  */
 void free_trace(trace_t *trace)
 {
-	free(trace->ops);         /* free the three arrays... */
+	if (trace->map != NULL)
+		munmap(trace->map, trace->map_len);
+	else
+		free(trace->ops);     /* free the three arrays... */
 	free(trace->blocks);      
 	free(trace->block_sizes);
 	free(trace);              /* and the trace record itself... */
@@ -584,7 +1398,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 	char *oldp;
 	char *p;
 
-	/* Reset the heap and free any records in the range list */
+	/* Reset the heap and free any records in the range index */
 	mem_reset_brk();
 	clear_ranges(ranges);
 
@@ -611,7 +1425,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 
 				/* 
 				 * Test the range of the new block for correctness and add it 
-				 * to the range list if OK. The block must be  be aligned properly,
+				 * to the range index if OK. The block must be  be aligned properly,
 				 * and must not overlap any currently allocated block. 
 				 */ 
 				if (add_range(ranges, p, size, tracenum, i) == 0)
@@ -638,10 +1452,10 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 					return 0;
 				}
 
-				/* Remove the old region from the range list */
+				/* Remove the old region from the range index */
 				remove_range(ranges, oldp);
 
-				/* Check new block for correctness and add it to range list */
+				/* Check new block for correctness and add it to range index */
 				if (add_range(ranges, newp, size, tracenum, i) == 0)
 					return 0;
 
@@ -653,7 +1467,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 				oldsize = trace->block_sizes[index];
 				if (size < oldsize) oldsize = size;
 				for (j = 0; j < oldsize; j++) {
-					if (newp[j] != (index & 0xFF)) {
+					if ((unsigned char)newp[j] != (index & 0xFF)) {
 						malloc_error(tracenum, i, "mm_realloc did not preserve the "
 								"data from old block");
 						return 0;
@@ -690,25 +1504,32 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
  *   an optimal allocator, i.e., no gaps and no internal fragmentation.
  *   Utilization is the ratio hwm/heapsize, where heapsize is the 
  *   size of the heap in bytes after running the student's malloc 
- *   package on the trace. Note that our implementation of mem_sbrk() 
- *   doesn't allow the students to decrement the brk pointer, so brk
- *   is always the high water mark of the heap. 
- *   
+ *   package on the trace. mem_sbrk() accepts a negative increment, but
+ *   only mm_compact uses one and it is not called here, so brk is
+ *   always the high water mark of the heap.
+ *   The allocator's counters for the whole run and its heap state at
+ *   the peak of live payload are saved in heapstats. If timeline is not
+ *   NULL, the state of the heap is written to it every interval requests
+ *   and after the last one.
  */
-static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
+static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges,
+		mm_stats_t *heapstats, FILE *timeline, int interval)
 {   
 	int i;
 	int index;
 	int size, newsize, oldsize;
 	int max_total_size = 0;
 	int total_size = 0;
+	int peak_op = find_peak(trace);
 	char *p;
 	char *newp, *oldp;
+	mm_stats_t end;
 
 	/* initialize the heap and the mm malloc package */
 	mem_reset_brk();
 	if (mm_init() < 0)
 		app_error("mm_init failed in eval_mm_util");
+	mm_stats(heapstats);
 
 	for (i = 0;  i < trace->num_ops;  i++) {
 		switch (trace->ops[i].type) {
@@ -772,8 +1593,16 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 				app_error("Nonexistent request type in eval_mm_util");
 
 		}
+		if (timeline != NULL && (i % interval == 0 || i == trace->num_ops - 1))
+			write_timeline(timeline, i, total_size);
+		if (i == peak_op)
+			mm_stats(heapstats);
 	}
 
+	/* By the end the trace has freed everything, so only the counters
+	 * are taken from there; they precede the heap state in mm_stats_t */
+	mm_stats(&end);
+	memcpy(heapstats, &end, offsetof(mm_stats_t, heap_bytes));
 	return ((double)max_total_size / (double)mem_heapsize());
 }
 
@@ -784,14 +1613,29 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
  */
 static void eval_mm_speed(void *ptr)
 {
-	int i, index, size, newsize;
-	char *p, *newp, *oldp, *block;
-	trace_t *trace = ((speed_t *)ptr)->trace;
+	setup_mm_speed(ptr);
+	replay_mm_speed(ptr);
+}
 
-	/* Reset the heap and initialize the mm package */
+/*
+ * setup_mm_speed - Reset the heap and initialize the mm package; -B
+ *    keeps this out of the timed region
+ */
+static void setup_mm_speed(void *ptr)
+{
 	mem_reset_brk();
 	if (mm_init() < 0) 
 		app_error("mm_init failed in eval_mm_speed");
+}
+
+/*
+ * replay_mm_speed - Replay the trace on an initialized mm package
+ */
+static void replay_mm_speed(void *ptr)
+{
+	int i, index, size, newsize;
+	char *p, *newp, *oldp, *block;
+	trace_t *trace = ((speed_t *)ptr)->trace;
 
 	/* Interpret each trace request */
 	for (i = 0;  i < trace->num_ops;  i++)
@@ -825,19 +1669,869 @@ static void eval_mm_speed(void *ptr)
 		}
 }
 
+/*********************************************************************
+ * The following routines replay traces against the backends loaded
+ * with -b, through their function tables (see backend.h)
+ ********************************************************************/
+
 /*
- * eval_libc_valid - We run this function to make sure that the
- *    libc malloc can run to completion on the set of traces.
- *    We'll be conservative and terminate if any libc malloc call fails.
- *
+ * eval_backend_valid - Check that a backend runs the trace correctly:
+ *     payloads must be aligned and must not overlap, and realloc must
+ *     keep the data. The heap extent of a backend is unknown, so it is
+ *     not checked. Errors do not count against mm.c.
  */
-static int eval_libc_valid(trace_t *trace, int tracenum)
+static int eval_backend_valid(backend_t *b, trace_t *trace, int tracenum,
+		range_t **ranges)
 {
-	int i, newsize;
-	char *p, *newp, *oldp;
-
-	for (i = 0;  i < trace->num_ops;  i++) {
-		switch (trace->ops[i].type) {
+	int i, j, index, size, oldsize;
+	char *p, *err = NULL;
+
+	clear_ranges(ranges);
+	if (backend_init(b) < 0) {
+		printf("ERROR [%s, trace %d]: init failed\n", b->name, tracenum);
+		return 0;
+	}
+	for (i = 0; i < trace->num_ops && err == NULL; i++) {
+		index = trace->ops[i].index;
+		size = trace->ops[i].size;
+		switch (trace->ops[i].type) {
+			case ALLOC:
+				if ((p = b->malloc(size)) == NULL) {
+					err = "malloc failed";
+					break;
+				}
+				if ((err = index_range(ranges, p, size)) != NULL)
+					break;
+				memset(p, index & 0xFF, size);
+				trace->blocks[index] = p;
+				trace->block_sizes[index] = size;
+				break;
+			case REALLOC:
+				remove_range(ranges, trace->blocks[index]);
+				if ((p = b->realloc(trace->blocks[index], size)) == NULL) {
+					err = "realloc failed";
+					break;
+				}
+				if ((err = index_range(ranges, p, size)) != NULL)
+					break;
+				oldsize = trace->block_sizes[index];
+				if (size < oldsize)
+					oldsize = size;
+				for (j = 0; j < oldsize; j++)
+					if ((unsigned char)p[j] != (index & 0xFF))
+						err = "realloc did not preserve the data from old block";
+				memset(p, index & 0xFF, size);
+				trace->blocks[index] = p;
+				trace->block_sizes[index] = size;
+				break;
+			case FREE:
+				remove_range(ranges, trace->blocks[index]);
+				b->free(trace->blocks[index]);
+				break;
+			default:
+				app_error("Nonexistent request type in eval_backend_valid");
+		}
+	}
+	if (err != NULL) {
+		printf("ERROR [%s, trace %d, line %d]: %s\n", b->name, tracenum,
+				LINENUM(i - 1), err);
+		return 0;
+	}
+	return 1;
+}
+
+/*
+ * eval_backend_util - Utilization of a backend, as in eval_mm_util; -1
+ *     if the backend cannot report the size of its heap
+ */
+static double eval_backend_util(backend_t *b, trace_t *trace)
+{
+	int i, index, size, total_size = 0, max_total_size = 0;
+
+	if (b->heap_size == NULL)
+		return -1;
+	if (backend_init(b) < 0)
+		app_error("init failed in eval_backend_util");
+	for (i = 0; i < trace->num_ops; i++) {
+		index = trace->ops[i].index;
+		size = trace->ops[i].size;
+		switch (trace->ops[i].type) {
+			case ALLOC:
+				if ((trace->blocks[index] = b->malloc(size)) == NULL)
+					app_error("malloc failed in eval_backend_util");
+				total_size += size;
+				trace->block_sizes[index] = size;
+				break;
+			case REALLOC:
+				trace->blocks[index] = b->realloc(trace->blocks[index], size);
+				if (trace->blocks[index] == NULL)
+					app_error("realloc failed in eval_backend_util");
+				total_size += size - trace->block_sizes[index];
+				trace->block_sizes[index] = size;
+				break;
+			case FREE:
+				b->free(trace->blocks[index]);
+				total_size -= trace->block_sizes[index];
+				break;
+		}
+		if (total_size > max_total_size)
+			max_total_size = total_size;
+	}
+	return (double)max_total_size / (double)b->heap_size();
+}
+
+/*
+ * eval_backend_speed - Replay a trace against a backend, for fsecs
+ */
+static void eval_backend_speed(void *ptr)
+{
+	setup_backend_speed(ptr);
+	replay_backend_speed(ptr);
+}
+
+/*
+ * setup_backend_speed - Start the backend on an empty heap
+ */
+static void setup_backend_speed(void *ptr)
+{
+	bspeed_t *sp = (bspeed_t *)ptr;
+	int i;
+
+	if (backend_init(sp->backend) < 0)
+		app_error("init failed in eval_backend_speed");
+	if (sp->touch > 0) {
+		/* every run starts with no live blocks and the same picks */
+		for (i = 0; i < sp->trace->num_ids; i++)
+			sp->live_pos[i] = -1;
+		sp->num_live = 0;
+		sp->credit = 0;
+		sp->rng = 0x9e3779b97f4a7c15ULL;
+	}
+}
+
+/*
+ * replay_backend_speed - Replay the trace on a started backend
+ */
+static void replay_backend_speed(void *ptr)
+{
+	backend_t *b = ((bspeed_t *)ptr)->backend;
+	trace_t *trace = ((bspeed_t *)ptr)->trace;
+	traceop_t *op;
+	int i;
+
+	if (((bspeed_t *)ptr)->touch > 0) {
+		replay_backend_touch((bspeed_t *)ptr);
+		return;
+	}
+	for (i = 0; i < trace->num_ops; i++) {
+		op = &trace->ops[i];
+		switch (op->type) {
+			case ALLOC:
+				if ((trace->blocks[op->index] = b->malloc(op->size)) == NULL)
+					app_error("malloc error in eval_backend_speed");
+				break;
+			case REALLOC:
+				trace->blocks[op->index] = b->realloc(trace->blocks[op->index],
+						op->size);
+				if (trace->blocks[op->index] == NULL)
+					app_error("realloc error in eval_backend_speed");
+				break;
+			case FREE:
+				b->free(trace->blocks[op->index]);
+				break;
+		}
+	}
+}
+
+/*
+ * setup_touch - Set up the live set of a touching replay of trace
+ */
+static void setup_touch(bspeed_t *sp, trace_t *trace, double touch)
+{
+	if (sp->live_ids == NULL || sp->trace != trace) {
+		free_touch(sp);
+		sp->live_ids = (int *)malloc(trace->num_ids * sizeof(int));
+		sp->live_pos = (int *)malloc(trace->num_ids * sizeof(int));
+		if (sp->live_ids == NULL || sp->live_pos == NULL)
+			unix_error("live set malloc in setup_touch failed");
+	}
+	sp->trace = trace;
+	sp->touch = touch;
+}
+
+/*
+ * free_touch - Free the live set of a touching replay
+ */
+static void free_touch(bspeed_t *sp)
+{
+	free(sp->live_ids);
+	free(sp->live_pos);
+	sp->live_ids = sp->live_pos = NULL;
+	sp->touch = 0;
+}
+
+/*
+ * replay_backend_touch - Replay the trace on a started backend the way
+ *     a program would use its blocks: each new or resized block is
+ *     written in full, and after each request a touch fraction of the
+ *     live blocks, picked at random, is read a cache line at a time.
+ *     Allocators that scatter live data pay for it in cache and TLB
+ *     misses here, where the plain replay never looks at a payload.
+ */
+static void replay_backend_touch(bspeed_t *sp)
+{
+	backend_t *b = sp->backend;
+	trace_t *trace = sp->trace;
+	traceop_t *op;
+	volatile char sink;
+	char *p;
+	size_t off, size;
+	int i, id, last;
+
+	for (i = 0; i < trace->num_ops; i++) {
+		op = &trace->ops[i];
+		id = op->index;
+		switch (op->type) {
+			case ALLOC:
+				if ((trace->blocks[id] = b->malloc(op->size)) == NULL)
+					app_error("malloc error in eval_backend_speed");
+				break;
+			case REALLOC:
+				trace->blocks[id] = b->realloc(trace->blocks[id], op->size);
+				if (trace->blocks[id] == NULL)
+					app_error("realloc error in eval_backend_speed");
+				break;
+			case FREE:
+				b->free(trace->blocks[id]);
+				/* swap the last live id into its slot */
+				last = sp->live_ids[--sp->num_live];
+				sp->live_ids[sp->live_pos[id]] = last;
+				sp->live_pos[last] = sp->live_pos[id];
+				sp->live_pos[id] = -1;
+				break;
+		}
+		if (op->type != FREE) {
+			memset(trace->blocks[id], id & 0xFF, op->size);
+			trace->block_sizes[id] = op->size;
+			if (sp->live_pos[id] < 0) {
+				sp->live_pos[id] = sp->num_live;
+				sp->live_ids[sp->num_live++] = id;
+			}
+		}
+
+		/* read the blocks owed so far */
+		sp->credit += sp->touch * sp->num_live;
+		while (sp->credit >= 1 && sp->num_live > 0) {
+			sp->credit -= 1;
+			id = sp->live_ids[(rng_next(&sp->rng) >> 33) % sp->num_live];
+			p = trace->blocks[id];
+			size = trace->block_sizes[id];
+			for (off = 0; off < size; off += 64)
+				sink = p[off];
+		}
+	}
+	(void)sink;
+}
+
+/*
+ * eval_mm_latency - Replay a trace once more, reading the cycle counter
+ *     around every request and adding the difference, less the cost of
+ *     reading the counter, to the histogram of the request type
+ */
+static void eval_mm_latency(trace_t *trace, lathist_t *lat, double overhead)
+{
+	int i, index;
+	unsigned long long t0, t1, ovhd = (unsigned long long)overhead;
+	char *p;
+
+	mem_reset_brk();
+	if (mm_init() < 0)
+		app_error("mm_init failed in eval_mm_latency");
+
+	for (i = 0; i < trace->num_ops; i++) {
+		index = trace->ops[i].index;
+		switch (trace->ops[i].type) {
+			case ALLOC:
+				t0 = read_counter();
+				p = mm_malloc(trace->ops[i].size);
+				t1 = read_counter();
+				if (p == NULL)
+					app_error("mm_malloc error in eval_mm_latency");
+				trace->blocks[index] = p;
+				break;
+			case REALLOC:
+				t0 = read_counter();
+				p = mm_realloc(trace->blocks[index], trace->ops[i].size);
+				t1 = read_counter();
+				if (p == NULL)
+					app_error("mm_realloc error in eval_mm_latency");
+				trace->blocks[index] = p;
+				break;
+			case FREE:
+				t0 = read_counter();
+				mm_free(trace->blocks[index]);
+				t1 = read_counter();
+				break;
+			default:
+				app_error("Nonexistent request type in eval_mm_latency");
+		}
+		lh_record(&lat[trace->ops[i].type], (t1 - t0 > ovhd) ? t1 - t0 - ovhd : 0);
+	}
+}
+
+/*
+ * eval_mm_sim - Replay a trace once more through the cache and TLB
+ *     model. mm.c reports its own references when it is built with
+ *     MM_SIM=1; the replay adds the payloads, each written in full when
+ *     it is allocated or resized.
+ */
+static void eval_mm_sim(trace_t *trace, sim_stats_t *sim)
+{
+	int i, index;
+	char *p;
+
+	mem_reset_brk();
+	sim_start(mem_heap_lo());
+	if (mm_init() < 0)
+		app_error("mm_init failed in eval_mm_sim");
+
+	for (i = 0; i < trace->num_ops; i++) {
+		index = trace->ops[i].index;
+		switch (trace->ops[i].type) {
+			case ALLOC:
+				if ((p = mm_malloc(trace->ops[i].size)) == NULL)
+					app_error("mm_malloc error in eval_mm_sim");
+				trace->blocks[index] = p;
+				sim_ref((size_t)p, trace->ops[i].size, SIM_PAYLOAD);
+				break;
+			case REALLOC:
+				p = mm_realloc(trace->blocks[index], trace->ops[i].size);
+				if (p == NULL)
+					app_error("mm_realloc error in eval_mm_sim");
+				trace->blocks[index] = p;
+				sim_ref((size_t)p, trace->ops[i].size, SIM_PAYLOAD);
+				break;
+			case FREE:
+				mm_free(trace->blocks[index]);
+				break;
+			default:
+				app_error("Nonexistent request type in eval_mm_sim");
+		}
+	}
+	sim_stop(sim);
+	if (sim->refs[SIM_META] == 0)
+		app_error("ERROR: mm.c was built without MM_SIM; use mdriver-sim for -C");
+}
+
+/*
+ * check_handle - Is the payload of handle h still filled with the byte
+ *     eval_mm_handles wrote into it?
+ */
+static int check_handle(mm_handle_t h, int id, size_t size)
+{
+	unsigned char *p = mm_hderef(h);
+	size_t k;
+
+	for (k = 0; k < size; k++)
+		if (p[k] != (unsigned char)id)
+			return 0;
+	return 1;
+}
+
+/*
+ * eval_mm_handles - Replay a trace with every block behind a handle,
+ *     calling mm_compact every interval requests. A realloc becomes a
+ *     new handle and a copy. Every payload is filled with its id, and
+ *     all of them are checked after each compaction to make sure the
+ *     moves kept the data.
+ */
+static void eval_mm_handles(trace_t *trace, int tracenum, int interval,
+		hstats_t *hs)
+{
+	mm_handle_t *handles, h;
+	size_t live = 0, peak_live = 0, peak_heap = 0, size, oldsize;
+	int i, id, k;
+
+	mem_reset_brk();
+	if (mm_init() < 0)
+		app_error("mm_init failed in eval_mm_handles");
+	handles = (mm_handle_t *)calloc(trace->num_ids, sizeof(mm_handle_t));
+	if (handles == NULL)
+		unix_error("calloc failed in eval_mm_handles");
+	memset(hs, 0, sizeof(*hs));
+
+	for (i = 0; i < trace->num_ops; i++) {
+		id = trace->ops[i].index;
+		size = trace->ops[i].size;
+		switch (trace->ops[i].type) {
+			case ALLOC:
+			case REALLOC:
+				if ((h = mm_halloc(size)) == 0) {
+					malloc_error(tracenum, i, "mm_halloc failed.");
+					free(handles);
+					return;
+				}
+				memset(mm_hderef(h), id, size);
+				if (handles[id] != 0) {
+					oldsize = trace->block_sizes[id];
+					memcpy(mm_hderef(h), mm_hderef(handles[id]),
+							(oldsize < size) ? oldsize : size);
+					mm_hfree(handles[id]);
+					live -= oldsize;
+				}
+				handles[id] = h;
+				trace->block_sizes[id] = size;
+				live += size;
+				break;
+			case FREE:
+				mm_hfree(handles[id]);
+				handles[id] = 0;
+				live -= trace->block_sizes[id];
+				break;
+			default:
+				app_error("Nonexistent request type in eval_mm_handles");
+		}
+		if (live > peak_live)
+			peak_live = live;
+		if (mem_heapsize() > peak_heap)
+			peak_heap = mem_heapsize();
+
+		if ((i + 1) % interval == 0) {
+			hs->trimmed += mm_compact();
+			hs->compactions++;
+			for (k = 0; k < trace->num_ids; k++) {
+				if (handles[k] != 0 &&
+						!check_handle(handles[k], k, trace->block_sizes[k])) {
+					sprintf(msg, "mm_compact lost the payload of id %d", k);
+					malloc_error(tracenum, i, msg);
+					free(handles);
+					return;
+				}
+			}
+		}
+	}
+	hs->util = (peak_heap == 0) ? 0 : (double)peak_live / peak_heap;
+	free(handles);
+}
+
+/*********************************************************************
+ * The following routines replay each thread of a trace on its own
+ * pthread to measure how the allocator behaves under concurrency. A
+ * thread waits before an op until every earlier op on the same id has
+ * been done, which orders cross-thread frees and reallocs after the
+ * allocation they refer to. mm.c is not thread safe, so its calls are
+ * serialized by a single lock; libc malloc is called directly.
+ *********************************************************************/
+
+static pthread_mutex_t mm_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * setup_threads - Split the ops of a trace by thread and number the ops
+ *     on each id
+ */
+static void setup_threads(trace_t *trace, threadrun_t *run)
+{
+	int i, t, *count;
+
+	run->trace = trace;
+	run->op_seq = (int *)malloc(trace->num_ops * sizeof(int));
+	run->id_done = (int *)calloc(trace->num_ids, sizeof(int));
+	run->workers = (tworker_t *)calloc(trace->num_threads, sizeof(tworker_t));
+	count = (int *)calloc(trace->num_ids, sizeof(int));
+	if (!run->op_seq || !run->id_done || !run->workers || !count)
+		unix_error("malloc failed in setup_threads");
+
+	for (i = 0; i < trace->num_ops; i++) {
+		run->op_seq[i] = count[trace->ops[i].index]++;
+		run->workers[trace->ops[i].tid].num_ops++;
+	}
+	for (t = 0; t < trace->num_threads; t++) {
+		run->workers[t].ops = (int *)malloc((run->workers[t].num_ops + 1) *
+				sizeof(int));
+		if (run->workers[t].ops == NULL)
+			unix_error("malloc failed in setup_threads");
+		run->workers[t].num_ops = 0;
+		run->workers[t].run = run;
+	}
+	for (i = 0; i < trace->num_ops; i++) {
+		t = trace->ops[i].tid;
+		run->workers[t].ops[run->workers[t].num_ops++] = i;
+	}
+	free(count);
+}
+
+/*
+ * free_threads - Free what setup_threads allocated
+ */
+static void free_threads(threadrun_t *run)
+{
+	int t;
+
+	for (t = 0; t < run->trace->num_threads; t++)
+		free(run->workers[t].ops);
+	free(run->workers);
+	free(run->op_seq);
+	free(run->id_done);
+}
+
+/*
+ * replay_thread - Body of one replay thread
+ */
+static void *replay_thread(void *arg)
+{
+	tworker_t *w = (tworker_t *)arg;
+	threadrun_t *run = w->run;
+	trace_t *trace = run->trace;
+	traceop_t *op;
+	int i, k;
+	char *p;
+
+	pthread_barrier_wait(&run->start);
+	for (k = 0; k < w->num_ops; k++) {
+		i = w->ops[k];
+		op = &trace->ops[i];
+
+		/* Wait for the earlier ops on this id, which may be on other threads */
+		while (__atomic_load_n(&run->id_done[op->index], __ATOMIC_ACQUIRE)
+				!= run->op_seq[i])
+			sched_yield();
+
+		if (!run->use_libc)
+			pthread_mutex_lock(&mm_lock);
+		switch (op->type) {
+			case ALLOC:
+				p = run->use_libc ? malloc(op->size) : mm_malloc(op->size);
+				if (p == NULL)
+					app_error("malloc failed in replay_thread");
+				trace->blocks[op->index] = p;
+				break;
+			case REALLOC:
+				p = trace->blocks[op->index];
+				p = run->use_libc ? realloc(p, op->size) : mm_realloc(p, op->size);
+				if (p == NULL)
+					app_error("realloc failed in replay_thread");
+				trace->blocks[op->index] = p;
+				break;
+			case FREE:
+				if (run->use_libc)
+					free(trace->blocks[op->index]);
+				else
+					mm_free(trace->blocks[op->index]);
+				break;
+		}
+		if (!run->use_libc)
+			pthread_mutex_unlock(&mm_lock);
+
+		__atomic_store_n(&run->id_done[op->index], run->op_seq[i] + 1,
+				__ATOMIC_RELEASE);
+	}
+	return NULL;
+}
+
+/*
+ * replay_threads - Start one pthread per trace thread, release them
+ *     together and wait for all of them to finish
+ */
+static void replay_threads(threadrun_t *run)
+{
+	trace_t *trace = run->trace;
+	int t;
+
+	memset(run->id_done, 0, trace->num_ids * sizeof(int));
+	pthread_barrier_init(&run->start, NULL, trace->num_threads);
+	for (t = 0; t < trace->num_threads; t++)
+		if (pthread_create(&run->workers[t].thread, NULL, replay_thread,
+					&run->workers[t]) != 0)
+			unix_error("pthread_create failed in replay_threads");
+	for (t = 0; t < trace->num_threads; t++)
+		pthread_join(run->workers[t].thread, NULL);
+	pthread_barrier_destroy(&run->start);
+}
+
+/*
+ * eval_mm_threads - Used by fsecs to time a concurrent replay with mm.c
+ */
+static void eval_mm_threads(void *ptr)
+{
+	threadrun_t *run = (threadrun_t *)ptr;
+
+	mem_reset_brk();
+	if (mm_init() < 0)
+		app_error("mm_init failed in eval_mm_threads");
+	run->use_libc = 0;
+	replay_threads(run);
+}
+
+/*
+ * eval_libc_threads - Used by fsecs to time a concurrent replay with libc
+ */
+static void eval_libc_threads(void *ptr)
+{
+	threadrun_t *run = (threadrun_t *)ptr;
+
+	run->use_libc = 1;
+	replay_threads(run);
+}
+
+/*********************************************************************
+ * The following routines replay traces that are too large to hold in
+ * memory. Ops are read in chunks by a background thread (see
+ * tracestream.h) and the blocks are tracked in a hash table that only
+ * holds live ids, so memory use follows the live set of the trace
+ * rather than its length.
+ *********************************************************************/
+
+/*
+ * slots_init - create an empty slot table
+ */
+static void slots_init(slotmap_t *map, unsigned nslots)
+{
+	unsigned i;
+
+	if ((map->slots = (slot_t *)malloc(nslots * sizeof(slot_t))) == NULL)
+		unix_error("malloc failed in slots_init");
+	for (i = 0; i < nslots; i++)
+		map->slots[i].id = -1;
+	map->mask = nslots - 1;
+	map->count = 0;
+}
+
+#define SLOT_HOME(map, id) (((unsigned)(id) * 2654435761u) & (map)->mask)
+
+/*
+ * slot_find - return the slot of a live id, or NULL
+ */
+static slot_t *slot_find(slotmap_t *map, int id)
+{
+	unsigned s;
+
+	for (s = SLOT_HOME(map, id); map->slots[s].id != -1; s = (s + 1) & map->mask)
+		if (map->slots[s].id == id)
+			return &map->slots[s];
+	return NULL;
+}
+
+/*
+ * slot_insert - claim a slot for id, doubling the table when it gets
+ *     half full
+ */
+static slot_t *slot_insert(slotmap_t *map, int id)
+{
+	slotmap_t bigger;
+	unsigned s;
+
+	if (2 * (map->count + 1) > map->mask + 1) {
+		slots_init(&bigger, 2 * (map->mask + 1));
+		for (s = 0; s <= map->mask; s++)
+			if (map->slots[s].id != -1)
+				*slot_insert(&bigger, map->slots[s].id) = map->slots[s];
+		free(map->slots);
+		*map = bigger;
+	}
+	for (s = SLOT_HOME(map, id); map->slots[s].id != -1; s = (s + 1) & map->mask)
+		;
+	map->slots[s].id = id;
+	map->count++;
+	return &map->slots[s];
+}
+
+/*
+ * slot_remove - free the slot of a freed id so it can be reused,
+ *     shifting later entries back to keep every probe sequence intact
+ */
+static void slot_remove(slotmap_t *map, slot_t *slot)
+{
+	unsigned s = slot - map->slots, next = s, home;
+
+	map->count--;
+	for (;;) {
+		map->slots[s].id = -1;
+		do {
+			next = (next + 1) & map->mask;
+			if (map->slots[next].id == -1)
+				return;
+			home = SLOT_HOME(map, map->slots[next].id);
+		} while ((s <= next) ? (s < home && home <= next)
+				: (s < home || home <= next));
+		map->slots[s] = map->slots[next];
+		s = next;
+	}
+}
+
+/*
+ * eval_mm_stream - Check the mm package on a trace streamed from disk,
+ *     then stream it again to measure utilization and throughput
+ */
+static void eval_mm_stream(char *tracedir, char *filename, int tracenum,
+		stats_t *stats, mm_stats_t *heapstats)
+{
+	char path[MAXLINE];
+	int peak_op = 0;
+
+	strcpy(path, tracedir);
+	strcat(path, filename);
+	if (verbose > 1)
+		printf("Streaming tracefile: %s\n", filename);
+
+	if (verbose > 1)
+		printf("Checking mm_malloc for correctness, ");
+	stats->valid = stream_pass(path, tracenum, 1, stats, heapstats, &peak_op);
+	if (stats->valid) {
+		if (verbose > 1)
+			printf("efficiency and performance.\n");
+		stats->valid = stream_pass(path, tracenum, 0, stats, heapstats, &peak_op);
+	}
+}
+
+/*
+ * stream_pass - Replay a streamed trace once. With check set, every
+ *     block is checked as in eval_mm_valid and the request at the peak
+ *     of live payload is saved in peak_op. Otherwise the pass records
+ *     the ops, the utilization, the heap state at peak_op and the time
+ *     spent replaying; the time is summed over chunks, so waits for the
+ *     reader and the mm_stats call are not counted.
+ */
+static int stream_pass(char *path, int tracenum, int check, stats_t *stats,
+		mm_stats_t *heapstats, int *peak_op)
+{
+	tracestream_t *ts;
+	tracefmt_hdr_t hdr;
+	tsop_t *ops;
+	slotmap_t map;
+	slot_t *slot;
+	range_t *ranges = NULL;
+	struct timeval stv, etv;
+	double secs = 0;
+	long total_size = 0, max_total_size = 0;
+	mm_stats_t end;
+	int opnum = 0, valid = 0;
+	int i, j, n, id, size, oldsize;
+	char *p;
+
+	if ((ts = ts_open(path, &hdr)) == NULL) {
+		sprintf(msg, "Could not open %s in stream_pass", path);
+		unix_error(msg);
+	}
+	slots_init(&map, 1024);
+
+	mem_reset_brk();
+	if (mm_init() < 0) {
+		malloc_error(tracenum, 0, "mm_init failed.");
+		goto out;
+	}
+
+	while ((n = ts_next(ts, &ops)) > 0) {
+		gettimeofday(&stv, NULL);
+		for (i = 0; i < n; i++, opnum++) {
+			id = ops[i].id;
+			size = ops[i].size;
+			slot = (ops[i].type == TRACEFMT_ALLOC) ? NULL : slot_find(&map, id);
+			if (ops[i].type != TRACEFMT_ALLOC && slot == NULL) {
+				malloc_error(tracenum, opnum, "request for an id that is not live");
+				goto out;
+			}
+
+			switch (ops[i].type) {
+				case TRACEFMT_ALLOC:
+					if ((p = mm_malloc(size)) == NULL) {
+						malloc_error(tracenum, opnum, "mm_malloc failed.");
+						goto out;
+					}
+					if (check) {
+						if (add_range(&ranges, p, size, tracenum, opnum) == 0)
+							goto out;
+						memset(p, id & 0xFF, size);
+					}
+					slot = slot_insert(&map, id);
+					slot->p = p;
+					slot->size = size;
+					total_size += size;
+					break;
+
+				case TRACEFMT_REALLOC:
+					if ((p = mm_realloc(slot->p, size)) == NULL) {
+						malloc_error(tracenum, opnum, "mm_realloc failed.");
+						goto out;
+					}
+					if (check) {
+						remove_range(&ranges, slot->p);
+						if (add_range(&ranges, p, size, tracenum, opnum) == 0)
+							goto out;
+						oldsize = (size < slot->size) ? size : slot->size;
+						for (j = 0; j < oldsize; j++) {
+							if ((unsigned char)p[j] != (id & 0xFF)) {
+								malloc_error(tracenum, opnum, "mm_realloc did not "
+										"preserve the data from old block");
+								goto out;
+							}
+						}
+						memset(p, id & 0xFF, size);
+					}
+					total_size += size - slot->size;
+					slot->p = p;
+					slot->size = size;
+					break;
+
+				case TRACEFMT_FREE:
+					if (check)
+						remove_range(&ranges, slot->p);
+					mm_free(slot->p);
+					total_size -= slot->size;
+					slot_remove(&map, slot);
+					break;
+			}
+			if (total_size > max_total_size) {
+				max_total_size = total_size;
+				if (check)
+					*peak_op = opnum;
+			}
+			if (!check && opnum == *peak_op) {
+				gettimeofday(&etv, NULL);
+				secs += (etv.tv_sec - stv.tv_sec) + 1E-6*(etv.tv_usec - stv.tv_usec);
+				mm_stats(heapstats);
+				gettimeofday(&stv, NULL);
+			}
+		}
+		gettimeofday(&etv, NULL);
+		secs += (etv.tv_sec - stv.tv_sec) + 1E-6*(etv.tv_usec - stv.tv_usec);
+	}
+	if (n < 0) {
+		malloc_error(tracenum, opnum, "malformed trace");
+		goto out;
+	}
+
+	if (!check) {
+		stats->ops = opnum;
+		stats->secs = secs;
+		stats->util = (double)max_total_size / (double)mem_heapsize();
+		mm_stats(&end);
+		memcpy(heapstats, &end, offsetof(mm_stats_t, heap_bytes));
+		if (verbose > 1)
+			printf("Replayed %d ops in %.3f secs, %.3f secs waiting for I/O\n",
+					opnum, secs, ts_stall_secs(ts));
+	}
+	valid = 1;
+
+out:
+	ts_close(ts);
+	clear_ranges(&ranges);
+	free(map.slots);
+	return valid;
+}
+
+/*
+ * eval_libc_valid - We run this function to make sure that the
+ *    libc malloc can run to completion on the set of traces.
+ *    We'll be conservative and terminate if any libc malloc call fails.
+ *
+ */
+static int eval_libc_valid(trace_t *trace, int tracenum)
+{
+	int i, newsize;
+	char *p, *newp, *oldp;
+
+	for (i = 0;  i < trace->num_ops;  i++) {
+		switch (trace->ops[i].type) {
 
 			case ALLOC: /* malloc */
 				if ((p = malloc(trace->ops[i].size)) == NULL) {
@@ -910,6 +2604,324 @@ static void eval_libc_speed(void *ptr)
 	}
 }
 
+/*********************************************************************
+ * The following routines evaluate traces in parallel (-j). main forks a
+ * worker for each trace, which runs the usual passes on its own copy of
+ * the memlib heap, pinned to a CPU that no other worker is using, and
+ * writes its part of main's result arrays back through a pipe.
+ ********************************************************************/
+
+static int worker_fd = -1;  /* write end of the result pipe, in a worker */
+static int worker_errors;   /* errors when the worker started */
+
+/*
+ * add_result - Note one part of the results of a trace; NULL parts,
+ *     for options that are not in use, are skipped
+ */
+static void add_result(results_t *res, void *base, size_t size)
+{
+	if (base == NULL)
+		return;
+	assert(res->n < MAXPARTS);
+	res->part[res->n].base = base;
+	res->part[res->n].size = size;
+	res->n++;
+}
+
+/*
+ * core_siblings - Add the hardware threads that share a core with cpu
+ *     to set, from a sysfs list such as "2,6" or "0-1"; just cpu itself
+ *     if the kernel does not say
+ */
+static void core_siblings(int cpu, cpu_set_t *set)
+{
+	FILE *fp;
+	char path[MAXLINE];
+	int lo, hi, c;
+
+	CPU_SET(cpu, set);
+	sprintf(path, "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list",
+			cpu);
+	if ((fp = fopen(path, "r")) == NULL)
+		return;
+	while (fscanf(fp, "%d", &lo) == 1) {
+		hi = lo;
+		if ((c = getc(fp)) == '-' && fscanf(fp, "%d", &hi) == 1)
+			c = getc(fp);
+		for (; lo <= hi && lo < CPU_SETSIZE; lo++)
+			CPU_SET(lo, set);
+		if (c != ',')
+			break;
+	}
+	fclose(fp);
+}
+
+/*
+ * init_workers - Make a slot for each of up to jobs physical cores this
+ *     process may run on, pinned to one hardware thread of each; timings
+ *     would not be comparable if workers shared a core, SMT siblings
+ *     included
+ */
+static void init_workers(workpool_t *pool, int jobs)
+{
+	cpu_set_t set, used;
+	int cpu, cores[CPU_SETSIZE], ncores = 0, n;
+
+	if (sched_getaffinity(0, sizeof(set), &set) < 0)
+		unix_error("sched_getaffinity failed in init_workers");
+	CPU_ZERO(&used);
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+		if (CPU_ISSET(cpu, &set) && !CPU_ISSET(cpu, &used)) {
+			cores[ncores++] = cpu;
+			core_siblings(cpu, &used);
+		}
+	if (jobs > ncores) {
+		printf("Only %d cores available; running %d workers\n",
+				ncores, ncores);
+		jobs = ncores;
+	}
+	if ((pool->slots = calloc(jobs, sizeof(worker_t))) == NULL)
+		unix_error("calloc failed in init_workers");
+	for (n = 0; n < jobs; n++)
+		pool->slots[n].cpu = cores[n];
+	pool->n = n;
+	if (verbose)
+		printf("Evaluating traces in %d worker processes.\n", n);
+}
+
+/*
+ * start_worker - Fork a worker for a trace once a slot is free. Like
+ *     fork, returns 0 in the worker, which goes on to evaluate the trace
+ *     and then calls finish_worker, and the worker's pid in the parent.
+ */
+static pid_t start_worker(workpool_t *pool, int tracenum, results_t *res)
+{
+	worker_t *w = NULL;
+	cpu_set_t set;
+	int i, fds[2];
+
+	while (w == NULL) {
+		for (i = 0; i < pool->n && w == NULL; i++)
+			if (pool->slots[i].pid == 0)
+				w = &pool->slots[i];
+		if (w == NULL)
+			reap_worker(pool);
+	}
+	if (pipe(fds) < 0)
+		unix_error("pipe failed in start_worker");
+	fflush(stdout);
+	if ((w->pid = fork()) < 0)
+		unix_error("fork failed in start_worker");
+	if (w->pid == 0) {
+		close(fds[0]);
+		for (i = 0; i < pool->n; i++)
+			if (pool->slots[i].pid != 0)
+				close(pool->slots[i].fd);
+		CPU_ZERO(&set);
+		CPU_SET(w->cpu, &set);
+		if (sched_setaffinity(0, sizeof(set), &set) < 0)
+			unix_error("sched_setaffinity failed in start_worker");
+		worker_fd = fds[1];
+		worker_errors = errors;
+		return 0;
+	}
+	close(fds[1]);
+	w->fd = fds[0];
+	w->tracenum = tracenum;
+	w->res = *res;
+	return w->pid;
+}
+
+/*
+ * finish_worker - Send the results of the trace to the parent and exit
+ */
+static void finish_worker(results_t *res)
+{
+	int i, nerrors = errors - worker_errors;
+	ssize_t n;
+	size_t off;
+
+	fflush(stdout);
+	for (i = -1; i < res->n; i++) {
+		char *base = (i < 0) ? (char *)&nerrors : res->part[i].base;
+		size_t size = (i < 0) ? sizeof(nerrors) : res->part[i].size;
+
+		for (off = 0; off < size; off += n)
+			if ((n = write(worker_fd, base + off, size - off)) <= 0)
+				_exit(1);
+	}
+	_exit(0);
+}
+
+/*
+ * reap_worker - Wait for a worker to send its results, copy them into
+ *     place and free its slot. A worker that dies before sending all of
+ *     them has hit an app_error, which stops mdriver as it would have
+ *     without -j.
+ */
+static void reap_worker(workpool_t *pool)
+{
+	struct pollfd pfds[pool->n];
+	worker_t *w = NULL;
+	int i, nerrors, status;
+	ssize_t n = 1;
+	size_t off;
+
+	for (i = 0; i < pool->n; i++) {
+		pfds[i].fd = pool->slots[i].pid ? pool->slots[i].fd : -1;
+		pfds[i].events = POLLIN;
+	}
+	while (poll(pfds, pool->n, -1) < 0)
+		if (errno != EINTR)
+			unix_error("poll failed in reap_worker");
+	for (i = 0; i < pool->n && w == NULL; i++)
+		if (pfds[i].revents)
+			w = &pool->slots[i];
+
+	for (i = -1; i < w->res.n && n > 0; i++) {
+		char *base = (i < 0) ? (char *)&nerrors : w->res.part[i].base;
+		size_t size = (i < 0) ? sizeof(nerrors) : w->res.part[i].size;
+
+		for (off = 0; off < size; off += n)
+			if ((n = read(w->fd, base + off, size - off)) <= 0)
+				break;
+	}
+	close(w->fd);
+	waitpid(w->pid, &status, 0);
+	w->pid = 0;
+	if (n <= 0) {
+		printf("Worker for trace %d failed\n", w->tracenum);
+		exit(1);
+	}
+	errors += nerrors;
+}
+
+/*
+ * wait_workers - Reap every worker still running
+ */
+static void wait_workers(workpool_t *pool)
+{
+	int i, busy;
+
+	do {
+		for (i = busy = 0; i < pool->n; i++)
+			busy += (pool->slots[i].pid != 0);
+		if (busy)
+			reap_worker(pool);
+	} while (busy);
+}
+
+/*********************************************************************
+ * The following routines save the results in a machine-readable form
+ * and compare them with a saved baseline (see report.c)
+ ********************************************************************/
+
+/*
+ * time_runs - Time f with fsecs runs times, storing the mean and the
+ *     standard deviation in stats
+ */
+static void time_runs(fsecs_test_funct f, void *argp, int runs,
+		stats_t *stats)
+{
+	double t, sum = 0, sumsq = 0;
+	int r;
+
+	for (r = 0; r < runs; r++) {
+		t = fsecs(f, argp);
+		sum += t;
+		sumsq += t * t;
+	}
+	stats->runs = runs;
+	stats->secs = sum / runs;
+	stats->secs_sd = (runs > 1) ?
+		sqrt(fmax(0, (sumsq - sum * sum / runs) / (runs - 1))) : 0;
+}
+
+/*
+ * bench_runs - Time run with bench; secs is the median of the runs, and
+ *     secs_sd and runs describe the runs kept, for the -c t-test
+ */
+static void bench_runs(bench_funct setup, bench_funct run, void *argp,
+		bench_opts_t *opts, stats_t *stats)
+{
+	bench_result_t r;
+
+	if (bench(setup, run, argp, opts, &r) < 0)
+		unix_error("bench failed in bench_runs");
+	stats->secs = r.median;
+	stats->secs_lo = r.lo;
+	stats->secs_hi = r.hi;
+	stats->secs_sd = r.sd;
+	stats->runs = r.runs - r.outliers;
+	stats->outliers = r.outliers;
+}
+
+/*
+ * to_report - Copy the mm results of each trace into a report
+ */
+static report_t *to_report(char **tracefiles, int n, stats_t *stats,
+		mm_stats_t *heapstats)
+{
+	report_t *r;
+	int i;
+
+	if ((r = (report_t *)calloc(n, sizeof(report_t))) == NULL)
+		unix_error("calloc failed in to_report");
+	for (i = 0; i < n; i++) {
+		snprintf(r[i].trace, REPORT_NAMELEN, "%s", tracefiles[i]);
+		r[i].valid = stats[i].valid;
+		r[i].ops = stats[i].ops;
+		if (!stats[i].valid)
+			continue;
+		r[i].secs = stats[i].secs;
+		r[i].secs_sd = stats[i].secs_sd;
+		r[i].runs = stats[i].runs;
+		r[i].util = stats[i].util;
+		if (heapstats != NULL)
+			r[i].heap = heapstats[i];
+	}
+	return r;
+}
+
+/*
+ * write_report - Write the mm results to path, as JSON if it ends in
+ *     .json and as CSV otherwise
+ */
+static int write_report(char *path, char **tracefiles, int n,
+		stats_t *stats, mm_stats_t *heapstats, double perfindex)
+{
+	report_t *r = to_report(tracefiles, n, stats, heapstats);
+	report_sum_t sum;
+	int rc;
+
+	sum.util_weight = UTIL_WEIGHT;
+	sum.libc_kops = AVG_LIBC_THRUPUT / 1e3;
+	sum.perfindex = perfindex;
+	rc = report_write(path, r, n, &sum);
+	free(r);
+	return rc;
+}
+
+/*
+ * compare_report - Compare the mm results with the baseline in path and
+ *     return the number of regressions
+ */
+static int compare_report(char *path, char **tracefiles, int n,
+		stats_t *stats, double threshold)
+{
+	report_t *base, *r = to_report(tracefiles, n, stats, NULL);
+	int nbase, regressions;
+
+	if ((nbase = report_read(path, &base)) < 0) {
+		sprintf(msg, "ERROR: could not read the baseline %s", path);
+		app_error(msg);
+	}
+	regressions = report_compare(base, nbase, r, n, threshold);
+	free(base);
+	free(r);
+	return regressions;
+}
+
 /*************************************
  * Some miscellaneous helper routines
  ************************************/
@@ -918,7 +2930,7 @@ static void eval_libc_speed(void *ptr)
 /*
  * printresults - prints a performance summary for some malloc package
  */
-static void printresults(int n, stats_t *stats) 
+static void printresults(int n, stats_t *stats, pcvals_t *ctrs) 
 {
 	int i;
 	double secs = 0;
@@ -970,6 +2982,452 @@ static void printresults(int n, stats_t *stats)
 				"-");
 	}
 
+	if (ctrs != NULL)
+		printcounters(n, stats, ctrs);
+}
+
+/*
+ * printcounters - prints the hardware events of each trace per request,
+ *     and over all the traces; "-" marks an event the host cannot count
+ */
+static void printcounters(int n, stats_t *stats, pcvals_t *ctrs)
+{
+	double total[PC_NEVENTS] = {0}, ops = 0;
+	int i, e;
+
+	printf("\nHardware events per request:\n");
+	printf("%5s", "trace");
+	for (e = 0; e < PC_NEVENTS; e++)
+		printf("%11s", pc_name(e));
+	printf("%6s\n", "IPC");
+	for (i = 0; i < n; i++) {
+		if (!stats[i].valid)
+			continue;
+		printf("%2d   ", i);
+		for (e = 0; e < PC_NEVENTS; e++) {
+			if (ctrs[i].count[e] < 0) {
+				printf("%11s", "-");
+				total[e] = -1;
+				continue;
+			}
+			printf("%11.1f", ctrs[i].count[e] / stats[i].ops);
+			if (total[e] >= 0)
+				total[e] += ctrs[i].count[e];
+		}
+		if (ctrs[i].count[PC_INSNS] > 0 && ctrs[i].count[PC_CYCLES] > 0)
+			printf("%6.2f\n", ctrs[i].count[PC_INSNS] / ctrs[i].count[PC_CYCLES]);
+		else
+			printf("%6s\n", "-");
+		ops += stats[i].ops;
+	}
+	if (ops == 0)
+		return;
+	printf("%-5s", "Total");
+	for (e = 0; e < PC_NEVENTS; e++) {
+		if (total[e] < 0)
+			printf("%11s", "-");
+		else
+			printf("%11.1f", total[e] / ops);
+	}
+	if (total[PC_INSNS] > 0 && total[PC_CYCLES] > 0)
+		printf("%6.2f\n", total[PC_INSNS] / total[PC_CYCLES]);
+	else
+		printf("%6s\n", "-");
+}
+
+/*
+ * printlatency - prints the latency percentiles of every request type
+ *     for each trace and over all the traces, in nanoseconds
+ */
+static void printlatency(int n, stats_t *stats, lathist_t *lat,
+		double overhead)
+{
+	static char *names[3] = {"malloc", "free", "realloc"};
+	lathist_t *all;
+	double ns = 1.0 / counter_ghz();
+	int i, t;
+
+	if ((all = (lathist_t *)calloc(3, sizeof(lathist_t))) == NULL)
+		unix_error("calloc failed in printlatency");
+	printf("Latency of mm malloc in ns (%.2f GHz counter, %.0f ticks of overhead removed):\n",
+			counter_ghz(), overhead);
+	printf("%5s%8s%9s%8s%8s%8s%8s%10s\n", "trace", "op", "count", "mean",
+			"p50", "p99", "p99.9", "max");
+	for (i = 0; i <= n; i++) {
+		if (i < n && !stats[i].valid)
+			continue;
+		for (t = 0; t < 3; t++) {
+			lathist_t *h = (i < n) ? &lat[3 * i + t] : &all[t];
+
+			if (i < n)
+				lh_merge(&all[t], h);
+			if (h->count == 0)
+				continue;
+			if (i < n)
+				printf("%2d", i);
+			else
+				printf("%-2s", t == 0 ? "*" : "");
+			printf("%11s%9llu%8.0f%8.0f%8.0f%8.0f%10.0f\n", names[t], h->count,
+					h->sum / h->count * ns, lh_percentile(h, 0.5) * ns,
+					lh_percentile(h, 0.99) * ns, lh_percentile(h, 0.999) * ns,
+					h->max * ns);
+		}
+	}
+	free(all);
+}
+
+/*
+ * printsim - prints the simulated misses of each level per request,
+ *     and the share of them caused by mm.c's own bookkeeping
+ */
+static void printsim(int n, stats_t *stats, sim_stats_t *sim)
+{
+	static char *names[SIM_NLEVELS] = {"L1", "L2", "TLB"};
+	sim_stats_t all;
+	sim_stats_t *s;
+	double ops, total, allops = 0;
+	int i, l;
+
+	memset(&all, 0, sizeof(all));
+	printf("Simulated misses per request (%s):\n", sim_describe());
+	printf("%5s%10s%10s", "trace", "ops", "lines/op");
+	for (l = 0; l < SIM_NLEVELS; l++)
+		printf("%8s/op%7s", names[l], "mm%");
+	printf("\n");
+	for (i = 0; i <= n; i++) {
+		if (i < n && !stats[i].valid)
+			continue;
+		s = (i < n) ? &sim[i] : &all;
+		ops = (i < n) ? stats[i].ops : allops;
+		if (i < n) {
+			allops += ops;
+			all.refs[SIM_META] += s->refs[SIM_META];
+			all.refs[SIM_PAYLOAD] += s->refs[SIM_PAYLOAD];
+			for (l = 0; l < SIM_NLEVELS; l++) {
+				all.miss[l][SIM_META] += s->miss[l][SIM_META];
+				all.miss[l][SIM_PAYLOAD] += s->miss[l][SIM_PAYLOAD];
+			}
+			printf("%2d", i);
+		}
+		else
+			printf("%-2s", "*");
+		if (ops == 0) {
+			printf("\n");
+			continue;
+		}
+		printf("%13.0f%10.2f", ops,
+				(s->refs[SIM_META] + s->refs[SIM_PAYLOAD]) / ops);
+		for (l = 0; l < SIM_NLEVELS; l++) {
+			total = s->miss[l][SIM_META] + s->miss[l][SIM_PAYLOAD];
+			printf("%11.3f%6.0f%%", total / ops,
+					total ? s->miss[l][SIM_META] / total * 100 : 0);
+		}
+		printf("\n");
+	}
+}
+
+/*
+ * printhandles - prints the utilization of each trace with plain blocks
+ *     and with movable ones compacted every -H requests
+ */
+static void printhandles(int n, stats_t *stats, hstats_t *hs)
+{
+	int i;
+
+	printf("Movable handles with compaction:\n");
+	printf("%5s%10s%10s%10s%12s\n", "trace", "util", "compacted",
+			"compacts", "KB trimmed");
+	for (i = 0; i < n; i++) {
+		if (!stats[i].valid)
+			continue;
+		printf("%2d%12.0f%%%9.0f%%%10d%12.0f\n", i, stats[i].util * 100,
+				hs[i].util * 100, hs[i].compactions, hs[i].trimmed / 1024.0);
+	}
+}
+
+/*
+ * printbench - prints the median time of each trace in microseconds,
+ *     with its 95% confidence interval and its relative half-width
+ */
+static void printbench(int n, stats_t *stats)
+{
+	int i;
+
+	printf("%5s%12s%12s%12s%8s%7s%9s\n", "trace", "median us", "ci low",
+			"ci high", "+/-", "runs", "outliers");
+	for (i = 0; i < n; i++) {
+		if (!stats[i].valid)
+			continue;
+		printf("%2d%15.2f%12.2f%12.2f%7.2f%%%7d%9d\n", i, stats[i].secs * 1e6,
+				stats[i].secs_lo * 1e6, stats[i].secs_hi * 1e6,
+				(stats[i].secs_hi - stats[i].secs_lo) / 2 / stats[i].secs * 100,
+				stats[i].runs + stats[i].outliers, stats[i].outliers);
+	}
+}
+
+/*
+ * printbackends - prints the utilization and throughput of mm.c and
+ *     each -b backend side by side, one pair of columns per allocator
+ */
+static void printbackends(int n, stats_t *mm, int nbackends,
+		backend_t **backends, stats_t **bstats)
+{
+	double util[MAXBACKENDS + 1] = {0}, secs[MAXBACKENDS + 1] = {0};
+	double ops[MAXBACKENDS + 1] = {0};
+	int i, b, nvalid[MAXBACKENDS + 1] = {0}, nutil[MAXBACKENDS + 1] = {0};
+	stats_t *st;
+
+	printf("Allocators compared (util, Kops):\n%5s%16s", "trace", "mm");
+	for (b = 0; b < nbackends; b++)
+		printf("%16.15s", backends[b]->name);
+	printf("\n");
+	for (i = 0; i < n; i++) {
+		printf("%2d   ", i);
+		for (b = 0; b <= nbackends; b++) {
+			st = (b == 0) ? &mm[i] : &bstats[b - 1][i];
+			if (!st->valid) {
+				printf("%16s", "invalid");
+				continue;
+			}
+			if (st->util >= 0) {
+				printf("%7.0f%%", st->util * 100);
+				util[b] += st->util;
+				nutil[b]++;
+			}
+			else
+				printf("%8s", "-");
+			printf("%8.0f", st->ops / 1e3 / st->secs);
+			secs[b] += st->secs;
+			ops[b] += st->ops;
+			nvalid[b]++;
+		}
+		printf("\n");
+	}
+	printf("%-5s", "Total");
+	for (b = 0; b <= nbackends; b++) {
+		if (nvalid[b] == 0) {
+			printf("%16s", "-");
+			continue;
+		}
+		if (nutil[b] > 0)
+			printf("%7.0f%%", util[b] / nutil[b] * 100);
+		else
+			printf("%8s", "-");
+		printf("%8.0f", ops[b] / 1e3 / secs[b]);
+	}
+	printf("\n");
+}
+
+/*
+ * printthreads - prints the throughput of the concurrent replays, next
+ *     to libc malloc if it was run
+ */
+static void printthreads(int n, int *nthreads, stats_t *mm, stats_t *libc)
+{
+	int i;
+
+	printf("Concurrent replay (mm calls serialized by one lock):\n");
+	printf("%5s%8s%8s%10s%8s%10s%8s\n", "trace", "threads", "ops",
+			"mm secs", "Kops", "libc secs", "Kops");
+	for (i = 0; i < n; i++) {
+		if (!mm[i].valid) {
+			printf("%2d%11s%8s%10s%8s%10s%8s\n", i, "-", "-", "-", "-", "-", "-");
+			continue;
+		}
+		printf("%2d%11d%8.0f%10.6f%8.0f", i, nthreads[i], mm[i].ops,
+				mm[i].secs, (mm[i].ops/1e3)/mm[i].secs);
+		if (libc != NULL && libc[i].valid)
+			printf("%10.6f%8.0f", libc[i].secs, (libc[i].ops/1e3)/libc[i].secs);
+		printf("\n");
+	}
+}
+
+/*
+ * write_profile - saves the heap profile of the util pass over a trace
+ *     as <trace>.heap in the current directory
+ */
+static void write_profile(char *tracefile)
+{
+	FILE *fp;
+	char path[MAXLINE];
+	char *base = strrchr(tracefile, '/');
+
+	sprintf(path, "%s.heap", base ? base + 1 : tracefile);
+	if ((fp = fopen(path, "w")) == NULL) {
+		unix_error(path);
+	}
+	mm_prof_dump(fp);
+	fclose(fp);
+	if (verbose > 1)
+		printf("Wrote heap profile to %s\n", path);
+}
+
+/*
+ * open_timeline - creates <trace>.util.csv in the current directory for
+ *     the utilization timeline of a trace and writes its header
+ */
+static FILE *open_timeline(char *tracefile)
+{
+	FILE *fp;
+	char path[MAXLINE];
+	char *base = strrchr(tracefile, '/');
+	int j;
+
+	sprintf(path, "%s.util.csv", base ? base + 1 : tracefile);
+	if ((fp = fopen(path, "w")) == NULL)
+		unix_error(path);
+	fprintf(fp, "op,live,heap,util,free,largest");
+	for (j = 0; j < MM_NBOXES; j++)
+		fprintf(fp, ",box%d", j);
+	fprintf(fp, "\n");
+	if (verbose > 1)
+		printf("Writing utilization timeline to %s\n", path);
+	return fp;
+}
+
+/*
+ * write_timeline - appends the state of the heap after request opnum:
+ *     the live payload bytes, the heap size, their ratio, the free bytes
+ *     and the largest free block, then the free bytes in each box
+ */
+static void write_timeline(FILE *fp, int opnum, int live)
+{
+	mm_stats_t hs;
+	int j;
+
+	mm_stats(&hs);
+	fprintf(fp, "%d,%d,%lu,%.4f,%lu,%lu", LINENUM(opnum), live,
+			(unsigned long)mem_heapsize(),
+			mem_heapsize() ? (double)live / mem_heapsize() : 0.0,
+			(unsigned long)hs.free_bytes, (unsigned long)hs.largest_free);
+	for (j = 0; j < MM_NBOXES; j++)
+		fprintf(fp, ",%lu", (unsigned long)hs.box_bytes[j]);
+	fprintf(fp, "\n");
+}
+
+/*
+ * find_peak - returns the index of the request after which the most
+ *     payload bytes are allocated. The peak depends only on the request
+ *     sizes, so nothing is allocated; block_sizes is overwritten.
+ */
+static int find_peak(trace_t *trace)
+{
+	int i, index, peak_op = 0;
+	int total_size = 0, max_total_size = 0;
+
+	for (i = 0;  i < trace->num_ops;  i++) {
+		index = trace->ops[i].index;
+		switch (trace->ops[i].type) {
+			case ALLOC:
+				total_size += trace->ops[i].size;
+				trace->block_sizes[index] = trace->ops[i].size;
+				break;
+			case REALLOC:
+				total_size += trace->ops[i].size - trace->block_sizes[index];
+				trace->block_sizes[index] = trace->ops[i].size;
+				break;
+			case FREE:
+				total_size -= trace->block_sizes[index];
+				break;
+		}
+		if (total_size > max_total_size) {
+			max_total_size = total_size;
+			peak_op = i;
+		}
+	}
+	return peak_op;
+}
+
+/*
+ * write_snapshot - replays a trace up to the request that leaves the
+ *     most payload bytes allocated and saves the heap layout at that
+ *     point as <trace>.snap in the current directory
+ */
+static void write_snapshot(trace_t *trace, char *tracefile)
+{
+	int i, index, peak_op = find_peak(trace);
+	FILE *fp;
+	char path[MAXLINE];
+	char *base = strrchr(tracefile, '/');
+
+	mem_reset_brk();
+	if (mm_init() < 0)
+		app_error("mm_init failed in write_snapshot");
+	for (i = 0;  i <= peak_op && i < trace->num_ops;  i++) {
+		index = trace->ops[i].index;
+		switch (trace->ops[i].type) {
+			case ALLOC:
+				if ((trace->blocks[index] = mm_malloc(trace->ops[i].size)) == NULL)
+					app_error("mm_malloc failed in write_snapshot");
+				break;
+			case REALLOC:
+				if ((trace->blocks[index] = mm_realloc(trace->blocks[index],
+								trace->ops[i].size)) == NULL)
+					app_error("mm_realloc failed in write_snapshot");
+				break;
+			case FREE:
+				mm_free(trace->blocks[index]);
+				break;
+		}
+	}
+
+	sprintf(path, "%s.snap", base ? base + 1 : tracefile);
+	if ((fp = fopen(path, "wb")) == NULL) {
+		unix_error(path);
+	}
+	if (mm_heap_snapshot(fp) < 0)
+		unix_error("mm_heap_snapshot failed in write_snapshot");
+	fclose(fp);
+	if (verbose > 1)
+		printf("Wrote heap snapshot at line %d to %s\n", LINENUM(peak_op), path);
+}
+
+/*
+ * printheapstats - prints the mm allocator counters and, at the peak of
+ *     live payload, the heap and the free list occupancy by box for each
+ *     trace that ran correctly
+ */
+static void printheapstats(int n, stats_t *stats, mm_stats_t *heapstats)
+{
+	int i, j;
+	mm_stats_t *hs;
+
+	printf("Allocator statistics for mm malloc (heap at peak live bytes):\n");
+	printf("%5s%8s%8s%8s%6s%8s%9s%7s%7s%9s%9s%6s\n",
+			"trace", "malloc", "free", "realloc", "sbrk", "splits",
+			"coalesce", "rinpl", "rcopy", "inuse", "freeb", "frag");
+	for (i=0; i < n; i++) {
+		if (!stats[i].valid)
+			continue;
+		hs = &heapstats[i];
+		printf("%2d%11lu%8lu%8lu%6lu%8lu%9lu%7lu%7lu%9lu%9lu%5.0f%%\n",
+				i,
+				hs->malloc_calls,
+				hs->free_calls,
+				hs->realloc_calls,
+				hs->sbrk_calls,
+				hs->splits,
+				hs->coalesces,
+				hs->realloc_inplace,
+				hs->realloc_copies + hs->realloc_moves,
+				(unsigned long)hs->inuse_bytes,
+				(unsigned long)hs->free_bytes,
+				hs->frag*100.0);
+	}
+
+	/* Free blocks in each box of the segregated list */
+	printf("\nFree blocks by box:\n%5s", "trace");
+	for (j=0; j < MM_NBOXES; j++)
+		printf("%6d", j);
+	printf("\n");
+	for (i=0; i < n; i++) {
+		if (!stats[i].valid)
+			continue;
+		printf("%2d   ", i);
+		for (j=0; j < MM_NBOXES; j++)
+			printf("%6lu", (unsigned long)heapstats[i].box_blocks[j]);
+		printf("\n");
+	}
 }
 
 /* 
@@ -1004,14 +3462,34 @@ void malloc_error(int tracenum, int opnum, char *msg)
  */
 static void usage(void) 
 {
-	fprintf(stderr, "Usage: mdriver [-hvVal] [-f <file>] [-t <dir>]\n");
+	fprintf(stderr, "Usage: mdriver [-hvValsSTLP] [-f <file>] [-t <dir>] [-p <bytes>] [-u <n>] [-j <n>]\n");
+	fprintf(stderr, "               [-b <so>] [-m <pct>] [-C <spec>] [-H <n>] [-R <n>] [-o <file>] [-c <file>] [-x <pct>] [-B [-w <n>] [-e <pct>]]\n");
 	fprintf(stderr, "Options\n");
 	fprintf(stderr, "\t-a         Don't check the team structure.\n");
+	fprintf(stderr, "\t-b <so>    Also replay against another allocator (mm, libc or a .so).\n");
+	fprintf(stderr, "\t-B         Time each trace until its median is known to within -e.\n");
+	fprintf(stderr, "\t-C <spec>  Count cache and TLB misses in a model (needs mdriver-sim).\n");
+	fprintf(stderr, "\t-c <file>  Compare with the baseline <file>; exit 2 on regressions.\n");
+	fprintf(stderr, "\t-e <pct>   Target half-width of the -B 95%% interval (default 1).\n");
 	fprintf(stderr, "\t-f <file>  Use <file> as the trace file.\n");
 	fprintf(stderr, "\t-g         Generate summary info for autograder.\n");
 	fprintf(stderr, "\t-h         Print this message.\n");
+	fprintf(stderr, "\t-H <n>     Also replay through movable handles, compacting every <n> requests.\n");
+	fprintf(stderr, "\t-j <n>     Evaluate <n> traces at once, each on its own core.\n");
 	fprintf(stderr, "\t-l         Run libc malloc as well.\n");
+	fprintf(stderr, "\t-m <pct>   Write each block and read <pct> of the live ones between requests.\n");
+	fprintf(stderr, "\t-L         Print latency percentiles of every request type.\n");
+	fprintf(stderr, "\t-o <file>  Write the results as CSV, or JSON if <file> ends in .json.\n");
+	fprintf(stderr, "\t-P         Count hardware events per request (implies -v).\n");
+	fprintf(stderr, "\t-R <n>     Time each trace <n> times (mean and deviation).\n");
+	fprintf(stderr, "\t-p <bytes> Sample a heap profile every <bytes> into <trace>.heap.\n");
+	fprintf(stderr, "\t-s         Save the heap layout at its peak into <trace>.snap.\n");
+	fprintf(stderr, "\t-S         Stream traces from disk (ignores -l, -p and -s).\n");
 	fprintf(stderr, "\t-t <dir>   Directory to find default traces.\n");
+	fprintf(stderr, "\t-T         Also replay the threads of each trace concurrently.\n");
+	fprintf(stderr, "\t-u <n>     Write the heap every <n> requests into <trace>.util.csv.\n");
 	fprintf(stderr, "\t-v         Print per-trace performance breakdowns.\n");
 	fprintf(stderr, "\t-V         Print additional debug info.\n");
+	fprintf(stderr, "\t-w <n>     Untimed warm-up runs of -B (default 2).\n");
+	fprintf(stderr, "\t-x <pct>   Throughput drop counted as a regression (default 5).\n");
 }
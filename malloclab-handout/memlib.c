@@ -52,14 +52,14 @@ void mem_reset_brk()
 
 /* 
  * mem_sbrk - simple model of the sbrk function. Extends the heap 
- *    by incr bytes and returns the start address of the new area. In
- *    this model, the heap cannot be shrunk.
+ *    by incr bytes and returns the start address of the new area. A
+ *    negative incr shrinks the heap (see mm_compact).
  */
 void *mem_sbrk(int incr) 
 {
 	char *old_brk = mem_brk;
 
-	if ( (incr < 0) || ((mem_brk + incr) > mem_max_addr)) {
+	if ( (mem_brk + incr < mem_start_brk) || ((mem_brk + incr) > mem_max_addr)) {
 		errno = ENOMEM;
 		fprintf(stderr, "ERROR: mem_sbrk failed. Ran out of memory...\n");
 		return (void *)-1;
@@ -1,5 +1,9 @@
 #include <unistd.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 void mem_init(void);               
 void mem_deinit(void);
 void *mem_sbrk(int incr);
@@ -9,3 +13,6 @@ void *mem_heap_hi(void);
 size_t mem_heapsize(void);
 size_t mem_pagesize(void);
 
+#ifdef __cplusplus
+}
+#endif
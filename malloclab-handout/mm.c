@@ -9,15 +9,31 @@
  * Each box links to a doubly linked list of free blocks in the size range;
  * free blocks have the structure of (header)(next)(prev)...(footer).
  * Of course, next and prev pointers are not necessary in allocated blocks.
+ * Links are word-sized offsets from the start of the heap in units of
+ * ALIGNMENT rather than raw pointers, so a free block stays 16 bytes on a
+ * 64-bit build. Block sizes are word-sized too, so the heap must stay
+ * below 4GB. A link of 0 ends a list, and the first block of a list has
+ * a prev link naming its box (HEAD_LINK), which no block link can reach.
+ *
+ * A box whose list gets long is also given a side array, an allocated
+ * block holding the size and link of each of its free blocks in list
+ * order, so run_list compares packed sizes instead of chasing a link per
+ * block. The 16 words below the box heads hold each box's array. Free
+ * blocks of box 1 and up, which are at least 40 bytes, keep their array
+ * index in the word after the prev link so a removal can find its entry.
  */
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
 #include <unistd.h>
 #include <string.h>
+#include <limits.h>
 
 #include "mm.h"
 #include "memlib.h"
+#include "mmprof.h"
+#include "heapsnap.h"
+#include "cachesim.h"
 
 /*********************************************************
  * NOTE TO STUDENTS: Before you do anything else, please
@@ -48,20 +64,32 @@ team_t team = {
 #define WSIZE 4 //word size
 #define DSIZE 8 //double word size
 #define CHUNKSIZE (1<<9) //extend the heap by CHUNKSIZE
+//largest request whose block mem_sbrk's int increment can still cover
+#define MAX_REQUEST ((size_t)0x7FFFFFFF-2*DSIZE)
 
 #define MAX(x,y) ((x) > (y)? (x) : (y)) //max of x and y
+#define MIN(x,y) ((x) < (y)? (x) : (y)) //min of x and y
 
 //size is a multiple of 8 so last three bits are available for alloc status
 #define PACK(size,alloc) ((size)|(alloc))
 
 //dereferences p, must cast first since p is type void *
-#define GET(p) (*(unsigned int *)(p))
-#define PUT(p,val) (*(unsigned int *)(p)=(val))
+//(SIM_REF reports the reference to the cache model in mdriver-sim)
+#define GET(p) (*(unsigned int *)SIM_REF(p,WSIZE))
+#define PUT(p,val) (*(unsigned int *)SIM_REF(p,WSIZE)=(val))
 
 //gets size or alloc status from a pointer
 #define GET_SIZE(p) (GET(p) & ~0x7)
 #define GET_ALLOC(p) (GET(p) & 0x1)
 
+//header bit of allocated blocks tracked by the heap profiler
+#define SAMPLED 0x2
+#define GET_SAMPLED(p) (GET(p) & SAMPLED)
+
+//header bit of allocated blocks that mm_compact may move (see mm_halloc)
+#define MOVABLE 0x4
+#define GET_MOVABLE(p) (GET(p) & MOVABLE)
+
 //given a block pointer, returns header or footer, could change if footer size changes
 #define HDRP(bp) ((char *)(bp) - WSIZE)
 #define FTRP(bp) ((char *)(bp) + GET_SIZE(HDRP(bp)) - DSIZE)
@@ -72,6 +100,260 @@ team_t team = {
 
 //Pointer to free list
 static char *free_listp;
+//Start of the heap, which free-list links are relative to
+static char *heap_base;
+
+//convert between block pointers and free-list links
+#define PTR_LINK(bp) ((unsigned int)(((char *)(bp)-heap_base)/ALIGNMENT))
+#define LINK_PTR(l) ((l) ? heap_base+(size_t)(l)*ALIGNMENT : NULL)
+
+//given a box number, gives the word holding the link to its first block
+#define BOXP(box) (free_listp+((box)*WSIZE))
+
+//prev link of the first block of a box; block links stay below 2**29
+#define HEAD_LINK(box) (0xFFFFFFF0u|(unsigned int)(box))
+#define IS_HEAD(l) ((l)>=0xFFFFFFF0u)
+#define HEAD_BOX(l) ((int)((l)&0xF))
+
+//Side arrays are (n)(cap)(live)(pad)(sizes[cap])(links[cap]), n counting
+//used entries, of which live are blocks and the rest 0-size tombstones.
+//A box's side word is 0, SIDE_WANT once run_list has asked for an array,
+//or the array's link. SIDE_STALE in n marks an array that missed a block.
+#define SIDEP(box) (heap_base+((box)*WSIZE))
+#define SIDE_WANT 1u
+#define SIDE_STALE 0xFFFFFFFFu
+#define SIDE_SCAN 32 //list steps after which run_list asks for an array
+#define SIDE_MINCAP 64
+#define SIDE_MINSIZE 40 //smallest block of box 1
+#define SA_N(sa) (sa)
+#define SA_CAP(sa) ((sa)+WSIZE)
+#define SA_LIVE(sa) ((sa)+2*WSIZE)
+#define SA_SIZE(sa,i) ((sa)+(4+(size_t)(i))*WSIZE)
+#define SA_LINK(sa,cap,i) ((sa)+(4+(size_t)(cap)+(size_t)(i))*WSIZE)
+//Index word of a free block in box 1 or up: its box and array entry
+#define IDXP(bp) ((char *)(bp)+DSIZE)
+#define IDX(box,i) (((unsigned int)(box)<<28)|(unsigned int)(i))
+#define IDX_BOX(x) ((int)((x)>>28))
+#define IDX_I(x) ((x)&0x0FFFFFFFu)
+
+//Handle table: each slot holds the link to a movable block and its pin
+//count, or, for a free slot, the next free handle and HFREE
+typedef struct {
+	unsigned int link;
+	unsigned int pins;
+} hslot_t;
+#define HFREE 0xFFFFFFFFu
+static hslot_t *htable;
+static unsigned int hcap; //slots in htable
+static unsigned int hfree; //first free handle, 0 if none
+
+//Set when a side array has been asked for or has gone stale
+static int side_pending;
+
+//Event counters reported by mm_stats, reset by mm_init
+#if MM_STATS
+static mm_stats_t counters;
+#define STAT_INC(field) (counters.field++)
+#define STAT_ADD(field,n) (counters.field += (n))
+#else
+#define STAT_INC(field)
+#define STAT_ADD(field,n)
+#endif
+
+//Charge size bytes to the profiler and sample bp when the countdown ends
+#define PROF_ALLOC(bp,size) do { \
+	if(mm_prof_interval && (mm_prof_countdown-=(long)(size))<0 && \
+			mm_prof_record((bp),(size))) \
+		PUT(HDRP(bp),GET(HDRP(bp))|SAMPLED); \
+} while(0)
+
+//Stop tracking bp in the profiler if it was sampled
+#define PROF_FREE(bp) do { \
+	if(GET_SAMPLED(HDRP(bp))) { \
+		PUT(HDRP(bp),GET(HDRP(bp))&~SAMPLED); \
+		mm_prof_forget(bp); \
+	} \
+} while(0)
+
+/*
+ * meta_alloc, meta_free - Allocate and free blocks for the allocator's own
+ *		use, which the event counters and the profiler do not see
+ */
+static char *meta_alloc(size_t size)
+{
+	size_t asize=DSIZE*((size+(DSIZE)+(DSIZE-1))/DSIZE);
+	char *bp;
+	if((bp=find_fit(asize))==NULL &&
+			(bp=extend_heap(MAX(asize,CHUNKSIZE)/WSIZE))==NULL)
+		return NULL;
+	place(bp,asize);
+	return bp;
+}
+
+static void meta_free(char *bp)
+{
+	size_t size=GET_SIZE(HDRP(bp));
+	PUT(HDRP(bp),PACK(size,0));
+	PUT(FTRP(bp),PACK(size,0));
+	add_to_free(coalesce(bp));
+}
+
+/*
+ * side_build - Replaces box's side array with one holding its current
+ *		list, with room for the list to grow by half
+ */
+static void side_build(int box)
+{
+	unsigned int sw=GET(SIDEP(box));
+	unsigned int n, cap, i;
+	char *sa, *bp;
+	//The old array goes back to the heap first and may land in this box
+	PUT(SIDEP(box),0);
+	if(sw>SIDE_WANT)
+		meta_free(LINK_PTR(sw));
+	for(n=0,bp=LINK_PTR(GET(BOXP(box)));bp!=NULL;bp=LINK_PTR(GET(bp)))
+		n++;
+	cap=MAX(SIDE_MINCAP,n+n/2);
+	sa=meta_alloc((4+2*(size_t)cap)*WSIZE);
+	//The search for the array may have asked for one for this box again
+	PUT(SIDEP(box),0);
+	if(sa==NULL)
+		return;
+	//Splitting the array's block off may have added to this box
+	for(n=0,bp=LINK_PTR(GET(BOXP(box)));bp!=NULL;bp=LINK_PTR(GET(bp)))
+		n++;
+	if(n>cap) {
+		meta_free(sa);
+		return;
+	}
+	PUT(SA_N(sa),n);
+	PUT(SA_CAP(sa),cap);
+	PUT(SA_LIVE(sa),n);
+	PUT(sa+3*WSIZE,0);
+	//The newest block, at the head of the list, is the last entry
+	i=n;
+	for(bp=LINK_PTR(GET(BOXP(box)));bp!=NULL;bp=LINK_PTR(GET(bp))) {
+		i--;
+		PUT(SA_SIZE(sa,i),GET_SIZE(HDRP(bp)));
+		PUT(SA_LINK(sa,cap,i),PTR_LINK(bp));
+		PUT(IDXP(bp),IDX(box,i));
+	}
+	PUT(SIDEP(box),PTR_LINK(sa));
+}
+
+/*
+ * side_fix - Builds the side arrays run_list asked for and rebuilds the
+ *		stale ones. Doing so allocates, which add_to_free and run_list
+ *		cannot do in the middle of an operation, so the entry points call
+ *		this before they touch the heap.
+ */
+static void side_fix(void)
+{
+	int box;
+	unsigned int sw;
+	while(side_pending) {
+		side_pending=0;
+		for(box=1;box<MM_NBOXES;box++) {
+			sw=GET(SIDEP(box));
+			if(sw==SIDE_WANT || (sw>SIDE_WANT &&
+					GET(SA_N(LINK_PTR(sw)))==SIDE_STALE))
+				side_build(box);
+		}
+	}
+}
+
+/*
+ * side_add - Appends a block that add_to_free has put at the head of box.
+ *		A full array is squeezed if at least half of it is tombstones and
+ *		is otherwise left stale for side_fix to rebuild.
+ */
+static void side_add(char *bp, int box, size_t size)
+{
+	unsigned int sw=GET(SIDEP(box));
+	unsigned int n, cap, live, i, j;
+	char *sa;
+	PUT(IDXP(bp),IDX(box,0));
+	if(sw<=SIDE_WANT || (n=GET(SA_N(sa=LINK_PTR(sw))))==SIDE_STALE)
+		return;
+	cap=GET(SA_CAP(sa));
+	live=GET(SA_LIVE(sa));
+	if(n==cap) {
+		if(live>cap/2) {
+			PUT(SA_N(sa),SIDE_STALE);
+			side_pending=1;
+			return;
+		}
+		for(i=j=0;i<n;i++) {
+			if(GET(SA_SIZE(sa,i))==0)
+				continue;
+			if(i!=j) {
+				PUT(SA_SIZE(sa,j),GET(SA_SIZE(sa,i)));
+				PUT(SA_LINK(sa,cap,j),GET(SA_LINK(sa,cap,i)));
+				PUT(IDXP(LINK_PTR(GET(SA_LINK(sa,cap,j)))),IDX(box,j));
+			}
+			j++;
+		}
+		n=j;
+	}
+	PUT(SA_SIZE(sa,n),size);
+	PUT(SA_LINK(sa,cap,n),PTR_LINK(bp));
+	PUT(IDXP(bp),IDX(box,n));
+	PUT(SA_N(sa),n+1);
+	PUT(SA_LIVE(sa),live+1);
+}
+
+/*
+ * side_remove - Leaves a tombstone for a block that is leaving its box,
+ *		dropping tombstones from the end of the array
+ */
+static void side_remove(char *bp)
+{
+	unsigned int x=GET(IDXP(bp));
+	unsigned int sw=GET(SIDEP(IDX_BOX(x)));
+	unsigned int n, i=IDX_I(x);
+	char *sa;
+	if(sw<=SIDE_WANT || (n=GET(SA_N(sa=LINK_PTR(sw))))==SIDE_STALE)
+		return;
+	PUT(SA_SIZE(sa,i),0);
+	PUT(SA_LIVE(sa),GET(SA_LIVE(sa))-1);
+	if(i==n-1) {
+		while(n>0 && GET(SA_SIZE(sa,n-1))==0)
+			n--;
+		PUT(SA_N(sa),n);
+	}
+}
+
+/*
+ * side_scan - First fit over the n entries of a side array. The last entry
+ *		is the head of the list, so scanning down from it picks the same
+ *		block as walking the list. Sizes are compared eight at a time.
+ */
+static void *side_scan(char *sa, unsigned int n, size_t size)
+{
+	unsigned int cap=GET(SA_CAP(sa));
+	unsigned int want=(unsigned int)size;
+	unsigned int hit, j;
+	unsigned int *sizes;
+	char *bp;
+	while(n>=8) {
+		sizes=(unsigned int *)SIM_REF(SA_SIZE(sa,n-8),8*WSIZE);
+		hit=0;
+		for(j=0;j<8;j++)
+			hit|=(sizes[j]>=want);
+		if(hit)
+			break;
+		n-=8;
+	}
+	while(n>0) {
+		n--;
+		if(GET(SA_SIZE(sa,n))>=want) {
+			bp=LINK_PTR(GET(SA_LINK(sa,cap,n)));
+			remove_from_free(bp);
+			return bp;
+		}
+	}
+	return NULL;
+}
 
 /* 
  * mm_init - initialize the malloc package.
@@ -79,9 +361,23 @@ static char *free_listp;
 int mm_init(void)
 {
 	int i;
-	//Push up break pointer by 20 words
-	if((free_listp = mem_sbrk(20*WSIZE)) == (void *)-1)
+#if MM_STATS
+	memset(&counters,0,sizeof(counters));
+#endif
+	mm_prof_reset();
+	heap_base=mem_heap_lo();
+	htable=NULL;
+	hcap=hfree=0;
+	side_pending=0;
+	//Push up break pointer by 36 words
+	if((free_listp = mem_sbrk(36*WSIZE)) == (void *)-1)
 		return -1;
+	STAT_INC(sbrk_calls);
+	STAT_ADD(sbrk_bytes,36*WSIZE);
+	//No box has a side array yet
+	for(i=0;i<16;i++)
+		PUT(free_listp+(i*WSIZE),0);
+	free_listp += 16*WSIZE;
 	PUT(free_listp,0);//padding word
 	//Initialize free list
 	free_listp += WSIZE;
@@ -110,8 +406,11 @@ void *mm_malloc(size_t size)
 	size_t extendsize;
 	char *bp;
 
-	if(size==0)
+	STAT_INC(malloc_calls);
+	if(size==0 || size>MAX_REQUEST)
 		return NULL;
+	if(side_pending)
+		side_fix();
 
 	if(size<=DSIZE)
 		asize=2*DSIZE;
@@ -119,17 +418,14 @@ void *mm_malloc(size_t size)
 		//Add overhead and round to nearest multiple of DSIZE
 		asize=DSIZE*((size+(DSIZE)+(DSIZE-1))/DSIZE);
 
-	//Search free list
-	if((bp=find_fit(asize))!=NULL) {
-		place(bp,asize);
-		return bp;
+	//Search free list, extending the heap if no free block is large enough
+	if((bp=find_fit(asize))==NULL) {
+		extendsize=MAX(asize,CHUNKSIZE);
+		if((bp=extend_heap(extendsize/WSIZE))==NULL)
+			return NULL;
 	}
-	
-	//Extend the heap if no free block is large enough
-	extendsize=MAX(asize,CHUNKSIZE);
-	if((bp=extend_heap(extendsize/WSIZE))==NULL)
-		return NULL;
 	place(bp,asize);
+	PROF_ALLOC(bp,size);
 	//if(mm_check()==0) {assert(0);}
 	return bp;
 }
@@ -141,6 +437,10 @@ void *mm_malloc(size_t size)
 void mm_free(void *ptr)
 {
 	size_t size = GET_SIZE(HDRP(ptr));
+	STAT_INC(free_calls);
+	if(side_pending)
+		side_fix();
+	PROF_FREE(ptr);
 	//Basically change alloc bit to 0
 	PUT(HDRP(ptr),PACK(size,0));
 	PUT(FTRP(ptr),PACK(size,0));
@@ -173,18 +473,20 @@ void *add_to_free(void *bp)
 {
 	size_t size = GET_SIZE(HDRP(bp));
 	int box = find_box(size);
-	size_t nextbp;
+	char *nextbp;
 	
-	nextbp=GET(free_listp+(box*WSIZE));
+	nextbp=LINK_PTR(GET(BOXP(box)));
 	/*
-	while((nextbp!=0)&&(GET_SIZE(HDRP(nextbp))>size))
-		nextbp=GET(nextbp);
+	while((nextbp!=NULL)&&(GET_SIZE(HDRP(nextbp))>size))
+		nextbp=LINK_PTR(GET(nextbp));
 		*/
-	PUT(bp,nextbp);//Next pointer
-	PUT(bp+WSIZE,(size_t)free_listp+(box*WSIZE));//Previous pointer
-	if(nextbp!=0)
-		PUT(nextbp+WSIZE,(size_t)bp);//Next block's previous pointer
-	PUT(free_listp+(box*WSIZE),((size_t)bp));//Box pointer
+	PUT(bp,GET(BOXP(box)));//Next link
+	PUT(bp+WSIZE,HEAD_LINK(box));//Previous link, the box points here
+	if(nextbp!=NULL)
+		PUT(nextbp+WSIZE,PTR_LINK(bp));//Next block's previous link
+	PUT(BOXP(box),PTR_LINK(bp));//Box link
+	if(box>0)
+		side_add(bp,box,size);
 	return bp;
 }
 
@@ -193,11 +495,15 @@ void *add_to_free(void *bp)
  */
 void remove_from_free(void *bp)
 {
-	size_t next = GET(bp);
-	char *pbp = (char *)GET(bp+WSIZE); //Previous block pointer
+	unsigned int next = GET(bp);
+	unsigned int prev = GET(bp+WSIZE);
+	//The next link of the previous block, or the box of the first block
+	char *pbp = IS_HEAD(prev) ? BOXP(HEAD_BOX(prev)) : LINK_PTR(prev);
+	if(GET_SIZE(HDRP(bp))>=SIDE_MINSIZE)
+		side_remove(bp);
 	PUT(pbp,next);
 	if(next!=0)
-		PUT(next+WSIZE,(size_t)pbp);
+		PUT(LINK_PTR(next)+WSIZE,prev);
 }
 
 /*
@@ -212,6 +518,8 @@ void *extend_heap(size_t words)
 	size=(words % 2) ? (words+1) * WSIZE : words * WSIZE;
 	if((long)(bp=mem_sbrk(size)) == -1)
 		return NULL;
+	STAT_INC(sbrk_calls);
+	STAT_ADD(sbrk_bytes,size);
 
 	//Add free block to heap
 	PUT(HDRP(bp),PACK(size,0));
@@ -239,6 +547,7 @@ void *coalesce(void *bp)
 
 	else if (prev_alloc && !next_alloc) {
 		//Be sure to remove old free blocks from the free list
+		STAT_INC(coalesces);
 		remove_from_free(NEXT_BLKP(bp));
 		size += GET_SIZE(HDRP(NEXT_BLKP(bp)));
 		PUT(HDRP(bp), PACK(size,0));
@@ -246,6 +555,7 @@ void *coalesce(void *bp)
 	}
 
 	else if (!prev_alloc && next_alloc) {
+		STAT_INC(coalesces);
 		remove_from_free(PREV_BLKP(bp));
 		size += GET_SIZE(HDRP(PREV_BLKP(bp)));
 		PUT(FTRP(bp), PACK(size,0));
@@ -254,6 +564,7 @@ void *coalesce(void *bp)
 	}
 
 	else {
+		STAT_ADD(coalesces,2);
 		remove_from_free(NEXT_BLKP(bp));
 		remove_from_free(PREV_BLKP(bp));
 		size += GET_SIZE(HDRP(PREV_BLKP(bp)))+
@@ -279,6 +590,7 @@ void place(void *bp, size_t asize)
 	//Note, free block is already removed from free list but alloc bit must be
 	//reset to 1
 	if((extr_spc = GET_SIZE(HDRP(bp))-asize)>=(2*DSIZE)) { 
+		STAT_INC(splits);
 		PUT(HDRP(bp),PACK(size,1));
 		PUT(FTRP(bp),PACK(size,1));
 		bpsplit=NEXT_BLKP(bp);//Next free block pointer
@@ -311,19 +623,28 @@ void *find_fit(size_t size)
 }
 
 /*
- * run_list - runs through an explicit free list
+ * run_list - runs through an explicit free list, or the box's side array
+ *		if it has one; a long walk asks for an array
  */
 void *run_list(int box, size_t size)
 {
 	char *bp;
-	bp=(char *)GET(free_listp+(box*WSIZE));
+	unsigned int sw, n, steps=0;
+	if(box>0 && (sw=GET(SIDEP(box)))>SIDE_WANT &&
+			(n=GET(SA_N(LINK_PTR(sw))))!=SIDE_STALE)
+		return side_scan(LINK_PTR(sw),n,size);
+	bp=LINK_PTR(GET(BOXP(box)));
 	while(bp!=0) {
 		if(GET_SIZE(HDRP(bp))>=size) {
 			remove_from_free(bp);
 			return bp;
 		}
 		else {
-			bp=(char *)GET(bp);
+			bp=LINK_PTR(GET(bp));
+		}
+		if(++steps==SIDE_SCAN && box>0 && GET(SIDEP(box))==0) {
+			PUT(SIDEP(box),SIDE_WANT);
+			side_pending=1;
 		}
 	}
 	return NULL;
@@ -335,6 +656,9 @@ void *run_list(int box, size_t size)
  */
 void *mm_realloc(void *bp, size_t size)
 {
+	STAT_INC(realloc_calls);
+	if(side_pending)
+		side_fix();
 	//Check simple cases
 	if(bp==NULL)
 		return mm_malloc(size);
@@ -342,7 +666,13 @@ void *mm_realloc(void *bp, size_t size)
 		mm_free(bp);
 		return NULL;
 	}
+	//Too large for a block; bp stays as it is
+	if(size>MAX_REQUEST)
+		return NULL;
 	
+	//The block is resized or replaced below, so it is no longer a sample
+	PROF_FREE(bp);
+
 	char *newbp=NULL;
 	size_t copySize = GET_SIZE(HDRP(bp));
 	//Try to "coalesce" with surrounding blocks before resorting to a
@@ -357,12 +687,13 @@ void *mm_realloc(void *bp, size_t size)
 		int extr_spc;
 		if((extr_spc=copySize-msize)>=(2*DSIZE)) {
 			//Split current block
+			STAT_INC(splits);
 			PUT(HDRP(bp),PACK(msize,1));
 			PUT(FTRP(bp),PACK(msize,1));
 			char *bpsplit=NEXT_BLKP(bp);
 			PUT(HDRP(bpsplit),PACK(extr_spc,0));
 			PUT(FTRP(bpsplit),PACK(extr_spc,0));
-			add_to_free(bpsplit);
+			add_to_free(coalesce(bpsplit));
 			newbp=bp;
 		}
 		else {
@@ -380,6 +711,7 @@ void *mm_realloc(void *bp, size_t size)
 		if(asize>=msize) {
 			remove_from_free(NEXT_BLKP(bp));
 			if((asize-msize)>=2*DSIZE) {
+				STAT_INC(splits);
 				PUT(HDRP(bp), PACK(msize,1));
 				PUT(FTRP(bp), PACK(msize,1));
 				char *bpsplit=NEXT_BLKP(bp);
@@ -403,12 +735,14 @@ void *mm_realloc(void *bp, size_t size)
 		if(asize>=msize) {
 			remove_from_free(PREV_BLKP(bp));
 			if((asize-msize)>=2*DSIZE) {
+				STAT_INC(splits);
 				newbp=PREV_BLKP(bp);
 				PUT(HDRP(newbp), PACK(msize,1));
 				char *bpsplit=NEXT_BLKP(newbp);
 				//Use memmove in case of overlapping data
 				//Do this before adding any new footers or headers
 				//that could overwrite data.
+				SIM_COPY(newbp,bp,copySize);
 				memmove(newbp,bp,copySize);
 				PUT(FTRP(newbp), PACK(msize,1));
 				PUT(HDRP(bpsplit),PACK(asize-msize,0));
@@ -419,6 +753,7 @@ void *mm_realloc(void *bp, size_t size)
 				PUT(FTRP(bp), PACK(asize,1));
 				PUT(HDRP(PREV_BLKP(bp)), PACK(asize,1));
 				newbp=PREV_BLKP(bp);
+				SIM_COPY(newbp,bp,copySize);
 				memmove(newbp,bp,copySize);
 			}
 		}
@@ -433,12 +768,14 @@ void *mm_realloc(void *bp, size_t size)
 			remove_from_free(NEXT_BLKP(bp));
 			remove_from_free(PREV_BLKP(bp));
 			if((asize-msize)>=2*DSIZE){
+				STAT_INC(splits);
 				newbp=PREV_BLKP(bp);
 				PUT(HDRP(newbp), PACK(msize,1));
 				char *bpsplit=NEXT_BLKP(newbp);
 				//Use memmove in case of overlapping data
 				//Do this before adding any new footers or headers
 				//that could overwrite data.
+				SIM_COPY(newbp,bp,copySize);
 				memmove(newbp,bp,copySize);
 				PUT(FTRP(newbp), PACK(msize,1));
 				PUT(HDRP(bpsplit),PACK(asize-msize,0));
@@ -446,9 +783,11 @@ void *mm_realloc(void *bp, size_t size)
 				add_to_free(bpsplit);
 			}
 			else {
-				PUT(FTRP(bp), PACK(asize,1));
+				//The merged block ends at the footer of the next block
+				PUT(FTRP(NEXT_BLKP(bp)), PACK(asize,1));
 				PUT(HDRP(PREV_BLKP(bp)), PACK(asize,1));
 				newbp=PREV_BLKP(bp);
+				SIM_COPY(newbp,bp,copySize);
 				memmove(newbp,bp,copySize);
 			}
 		}
@@ -457,16 +796,263 @@ void *mm_realloc(void *bp, size_t size)
 	}
 
 	if(noSpace) {
-		newbp=mm_malloc(size);
+		if((newbp=mm_malloc(size))==NULL)
+			return NULL;
 		//Copy over memory and free pointer
+		SIM_COPY(newbp,bp,copySize);
 		memcpy(newbp,bp,copySize);
 		mm_free(bp);
+		STAT_INC(realloc_copies);
+		STAT_ADD(realloc_copy_bytes,copySize);
+	}
+	else if(newbp!=bp) {
+		STAT_INC(realloc_moves);
+		STAT_ADD(realloc_copy_bytes,copySize);
 	}
+	else
+		STAT_INC(realloc_inplace);
+	//mm_malloc already offered the new block to the profiler
+	if(!noSpace)
+		PROF_ALLOC(newbp,size);
 
 	//if(mm_check()==0) {assert(0);}
 	return newbp;
 }
 
+/*
+ * mm_memalign - Allocate a block whose payload is a multiple of alignment,
+ *		which must be a power of two. A fit is taken with enough slack
+ *		for a free block of at least the minimum size in front of the
+ *		aligned payload; that leading block goes back on the free list
+ *		and place() trims the tail as usual.
+ */
+void *mm_memalign(size_t alignment, size_t size)
+{
+	size_t asize, needsize, lead, total;
+	char *bp, *abp;
+
+	if(alignment<=ALIGNMENT)
+		return mm_malloc(size);
+	STAT_INC(malloc_calls);
+	if(side_pending)
+		side_fix();
+	if(size==0 || alignment>MAX_REQUEST/2 || size>MAX_REQUEST-alignment-2*DSIZE)
+		return NULL;
+
+	if(size<=DSIZE)
+		asize=2*DSIZE;
+	else
+		asize=DSIZE*((size+(DSIZE)+(DSIZE-1))/DSIZE);
+	needsize=asize+alignment+2*DSIZE;
+
+	if((bp=find_fit(needsize))==NULL) {
+		if((bp=extend_heap(MAX(needsize,CHUNKSIZE)/WSIZE))==NULL)
+			return NULL;
+	}
+	//Unless the fit is already aligned, leave room for a minimum size free
+	//block before the payload
+	abp=bp;
+	if((size_t)bp & (alignment-1)) {
+		abp=(char *)(((size_t)bp+2*DSIZE+alignment-1) & ~(alignment-1));
+		lead=abp-(char *)bp;
+		total=GET_SIZE(HDRP(bp));
+		PUT(HDRP(bp),PACK(lead,0));
+		PUT(FTRP(bp),PACK(lead,0));
+		PUT(HDRP(abp),PACK(total-lead,0));
+		PUT(FTRP(abp),PACK(total-lead,0));
+		STAT_INC(splits);
+		add_to_free(bp);
+	}
+
+	place(abp,asize);
+	PROF_ALLOC(abp,size);
+	//if(mm_check()==0) {assert(0);}
+	return abp;
+}
+
+/*
+ * mm_usable_size - Number of payload bytes in an allocated block, which
+ *		can be more than were asked for
+ */
+size_t mm_usable_size(void *bp)
+{
+	return GET_SIZE(HDRP(bp))-DSIZE;
+}
+
+/*
+ * grow_handles - Doubles the handle table. The table lives in a movable
+ *		block of its own, whose first word is 0 rather than a handle.
+ */
+static int grow_handles(void)
+{
+	unsigned int n = hcap ? 2*hcap : 64;
+	unsigned int i;
+	hslot_t *table;
+	char *bp;
+	if((bp=mm_malloc(n*sizeof(hslot_t)+DSIZE))==NULL)
+		return -1;
+	PUT(HDRP(bp),GET(HDRP(bp))|MOVABLE);
+	PUT(bp,0);
+	table=(hslot_t *)(bp+DSIZE);
+	if(htable!=NULL) {
+		memcpy(table,htable,hcap*sizeof(hslot_t));
+		mm_free((char *)htable-DSIZE);
+	}
+	//Chain the new slots so the lowest handle is used first
+	for(i=n;i>hcap;i--) {
+		table[i-1].link=hfree;
+		table[i-1].pins=HFREE;
+		hfree=i;
+	}
+	htable=table;
+	hcap=n;
+	return 0;
+}
+
+/*
+ * mm_halloc - allocates a movable block of at least size bytes and
+ *		returns its handle, or 0. The block is (header)(handle)(pad)
+ *		(payload)...(footer), the handle word telling mm_compact which
+ *		slot to update when it moves the block.
+ */
+mm_handle_t mm_halloc(size_t size)
+{
+	mm_handle_t h;
+	char *bp;
+	if(size>MAX_REQUEST-DSIZE)
+		return 0;
+	if(hfree==0 && grow_handles()<0)
+		return 0;
+	if((bp=mm_malloc(size+DSIZE))==NULL)
+		return 0;
+	h=hfree;
+	hfree=htable[h-1].link;
+	htable[h-1].link=PTR_LINK(bp);
+	htable[h-1].pins=0;
+	PUT(HDRP(bp),GET(HDRP(bp))|MOVABLE);
+	PUT(bp,h);
+	return h;
+}
+
+/*
+ * mm_hderef - returns the current address of a handle's payload, or
+ *		NULL for handle 0
+ */
+void *mm_hderef(mm_handle_t h)
+{
+	if(h==0)
+		return NULL;
+	return LINK_PTR(htable[h-1].link)+DSIZE;
+}
+
+/*
+ * mm_hfree - frees a handle's block and the handle; handle 0, which
+ *		mm_halloc returns on failure, is ignored like free(NULL)
+ */
+void mm_hfree(mm_handle_t h)
+{
+	if(h==0)
+		return;
+	mm_free(LINK_PTR(htable[h-1].link));
+	htable[h-1].link=hfree;
+	htable[h-1].pins=HFREE;
+	hfree=h;
+}
+
+/*
+ * mm_hpin, mm_hunpin - a pinned block is not moved by mm_compact
+ */
+void mm_hpin(mm_handle_t h)
+{
+	if(h!=0)
+		htable[h-1].pins++;
+}
+
+void mm_hunpin(mm_handle_t h)
+{
+	if(h!=0)
+		htable[h-1].pins--;
+}
+
+/*
+ * mm_compact - Slides every unpinned movable block down over the free
+ *		space below it, then gives the free space left at the top of the
+ *		heap back with mem_sbrk. The gaps left before blocks that cannot
+ *		move become the new free lists. Returns the bytes given back.
+ */
+size_t mm_compact(void)
+{
+	char *bp, *next, *dest = NULL;
+	size_t size, gap, left, step;
+	unsigned int h, sw;
+	int i;
+	//Every free block ends up in a gap, so the lists are rebuilt. The side
+	//arrays are marked free to become part of the gaps too.
+	for(i=0;i<MM_NBOXES;i++) {
+		if((sw=GET(SIDEP(i)))>SIDE_WANT) {
+			bp=LINK_PTR(sw);
+			size=GET_SIZE(HDRP(bp));
+			PUT(HDRP(bp),PACK(size,0));
+			PUT(FTRP(bp),PACK(size,0));
+		}
+		PUT(SIDEP(i),0);
+		PUT(BOXP(i),0);
+	}
+	side_pending=0;
+	for(bp=NEXT_BLKP(free_listp+(17*WSIZE));(size=GET_SIZE(HDRP(bp)))!=0;
+			bp=next) {
+		next=bp+size;
+		if(!GET_ALLOC(HDRP(bp))) {
+			//A gap starts at the first free block after a fixed one
+			if(dest==NULL)
+				dest=bp;
+			continue;
+		}
+		if(dest==NULL)
+			continue;
+		h=GET_MOVABLE(HDRP(bp)) ? GET(bp) : 0;
+		if(GET_MOVABLE(HDRP(bp)) && (h==0 || htable[h-1].pins==0)) {
+			if(GET_SAMPLED(HDRP(bp)))
+				mm_prof_move(bp,dest);
+			SIM_COPY(HDRP(dest),HDRP(bp),size);
+			memmove(HDRP(dest),HDRP(bp),size);
+			if(h!=0)
+				htable[h-1].link=PTR_LINK(dest);
+			else
+				htable=(hslot_t *)(dest+DSIZE);
+			dest+=size;
+		}
+		else {
+			//Close the gap below a block that cannot move
+			gap=bp-dest;
+			PUT(HDRP(dest),PACK(gap,0));
+			PUT(FTRP(dest),PACK(gap,0));
+			add_to_free(dest);
+			dest=NULL;
+		}
+	}
+	if(dest==NULL)
+		return 0;
+	//bp is now past the epilogue; everything from dest up is free.
+	//mem_sbrk takes an int, so a gap over 2GB is trimmed in steps
+	gap=bp-dest;
+	left=gap;
+	while(left>0) {
+		step=MIN(left,(size_t)INT_MAX&~(size_t)(ALIGNMENT-1));
+		if(mem_sbrk(-(int)step)==(void *)-1)
+			break;
+		left-=step;
+	}
+	if(left>0) {
+		//Whatever could not be given back stays as one free block
+		PUT(HDRP(dest),PACK(left,0));
+		PUT(FTRP(dest),PACK(left,0));
+		add_to_free(dest);
+	}
+	PUT(HDRP(dest+left),PACK(0,1));//new epilogue
+	return gap-left;
+}
+
 /*
  * mm_check - Heap consistency checker. Checks that certain properties of
  *		the heap are correct.
@@ -476,12 +1062,13 @@ int mm_check(void)
 	//Is every block in the free list marked as free?
 	//Are there any contiguous free blocks that somehow escaped coalescing?
 	int i;
-	char *bp;
+	char *bp, *sa;
 	size_t prev_alloc;	
 	size_t next_alloc;
+	unsigned int sw, n, cap, live, j;
 	//Iterate through the free list
 	for(i=0;i<16;i++) {
-		bp=(char *)GET(free_listp+i*WSIZE);
+		bp=LINK_PTR(GET(BOXP(i)));
 		while(bp!=0) {
 			//Check the allocate bit is free
 			if(GET_ALLOC(HDRP(bp))!=0) {
@@ -495,7 +1082,31 @@ int mm_check(void)
 				printf("Uncoalesced free blocks.\n");
 				return 0;
 			}
-			bp=(char *)GET(bp);
+			bp=LINK_PTR(GET(bp));
+		}
+	}
+	//Does every side array hold exactly its box's list?
+	for(i=1;i<16;i++) {
+		if((sw=GET(SIDEP(i)))<=SIDE_WANT ||
+				(n=GET(SA_N(sa=LINK_PTR(sw))))==SIDE_STALE)
+			continue;
+		cap=GET(SA_CAP(sa));
+		for(live=0,j=0;j<n;j++) {
+			if(GET(SA_SIZE(sa,j))==0)
+				continue;
+			live++;
+			bp=LINK_PTR(GET(SA_LINK(sa,cap,j)));
+			if(GET_SIZE(HDRP(bp))!=GET(SA_SIZE(sa,j)) ||
+					GET(IDXP(bp))!=IDX(i,j) || find_box(GET(SA_SIZE(sa,j)))!=i) {
+				printf("Side array entry does not match its block.\n");
+				return 0;
+			}
+		}
+		for(j=0,bp=LINK_PTR(GET(BOXP(i)));bp!=0;bp=LINK_PTR(GET(bp)))
+			j++;
+		if(n>cap || live!=GET(SA_LIVE(sa)) || live!=j) {
+			printf("Side array does not match its free list.\n");
+			return 0;
 		}
 	}
 	//Is every free block actually in the free list?
@@ -520,13 +1131,114 @@ int in_free_list(void *bp)
 	int i;
 	char *ibp;
 	for(i=0;i<16;i++) {
-		ibp=(char *)GET(free_listp+i*WSIZE);
+		ibp=LINK_PTR(GET(BOXP(i)));
 		while(ibp!=0) {
 			//Check if blocks are the same
 			if(ibp==bp)
 				return 1;
-			ibp=(char *)GET(ibp);
+			ibp=LINK_PTR(GET(ibp));
 		}
 	}
 	return 0;
 }
+
+/*
+ * mm_stats - Fills in the event counters and walks the heap and the
+ *		free list to describe the current heap state.
+ */
+void mm_stats(mm_stats_t *stats)
+{
+	int i;
+	char *bp;
+	size_t size;
+#if MM_STATS
+	*stats=counters;
+#else
+	memset(stats,0,sizeof(*stats));
+#endif
+	stats->heap_bytes=mem_heapsize();
+	//Walk every block between the prologue and the epilogue
+	for(bp=NEXT_BLKP(free_listp+(17*WSIZE));(size=GET_SIZE(HDRP(bp)))!=0;
+			bp=NEXT_BLKP(bp)) {
+		if(GET_ALLOC(HDRP(bp))) {
+			stats->inuse_blocks++;
+			stats->inuse_bytes+=size;
+		}
+		else {
+			stats->free_blocks++;
+			stats->free_bytes+=size;
+			if(size>stats->largest_free)
+				stats->largest_free=size;
+		}
+	}
+	//Count what each box of the free list holds
+	for(i=0;i<MM_NBOXES;i++) {
+		bp=LINK_PTR(GET(BOXP(i)));
+		while(bp!=0) {
+			stats->box_blocks[i]++;
+			stats->box_bytes[i]+=GET_SIZE(HDRP(bp));
+			bp=LINK_PTR(GET(bp));
+		}
+	}
+	stats->frag=(stats->free_bytes==0) ? 0.0 :
+		1.0-(double)stats->largest_free/(double)stats->free_bytes;
+}
+
+/*
+ * mm_heap_walk - Calls fn on every block between the prologue and the
+ *		epilogue, in address order.
+ */
+void mm_heap_walk(mm_walk_fn fn, void *arg)
+{
+	char *bp;
+	size_t size;
+	for(bp=NEXT_BLKP(free_listp+(17*WSIZE));(size=GET_SIZE(HDRP(bp)))!=0;
+			bp=NEXT_BLKP(bp))
+		fn(bp,size,GET_ALLOC(HDRP(bp)),arg);
+}
+
+/*
+ * put_word - Writes a word to a snapshot in little-endian order
+ */
+static void put_word(FILE *fp, unsigned int val)
+{
+	fputc(val & 0xff,fp);
+	fputc((val >> 8) & 0xff,fp);
+	fputc((val >> 16) & 0xff,fp);
+	fputc((val >> 24) & 0xff,fp);
+}
+
+/*
+ * count_block - mm_heap_walk callback counting the blocks in the heap
+ */
+static void count_block(void *bp, size_t size, int alloc, void *arg)
+{
+	(*(unsigned int *)arg)++;
+}
+
+/*
+ * snapshot_block - mm_heap_walk callback writing one snapshot record
+ */
+static void snapshot_block(void *bp, size_t size, int alloc, void *arg)
+{
+	FILE *fp=arg;
+	put_word(fp,(unsigned int)(HDRP(bp)-(char *)mem_heap_lo()));
+	put_word(fp,PACK(size,alloc));
+	fputc(find_box(size),fp);
+}
+
+/*
+ * mm_heap_snapshot - Writes the header and block records described in
+ *		heapsnap.h for the current heap.
+ */
+int mm_heap_snapshot(FILE *fp)
+{
+	unsigned int nblocks=0;
+	mm_heap_walk(count_block,&nblocks);
+	fwrite(HEAPSNAP_MAGIC,1,4,fp);
+	put_word(fp,HEAPSNAP_VERSION);
+	put_word(fp,(unsigned int)mem_heapsize());
+	put_word(fp,nblocks);
+	mm_heap_walk(snapshot_block,fp);
+	return ferror(fp) ? -1 : 0;
+}
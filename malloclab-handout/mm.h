@@ -1,9 +1,18 @@
+#ifndef __MM_H_
+#define __MM_H_
+
 #include <stdio.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 extern int mm_init (void);
 extern void *mm_malloc (size_t size);
 extern void mm_free (void *ptr);
 extern void *mm_realloc(void *ptr, size_t size);
+extern void *mm_memalign(size_t alignment, size_t size);
+extern size_t mm_usable_size(void *ptr);
 int mm_check(void);
 int find_box(size_t size);
 void *extend_heap(size_t words);
@@ -15,6 +24,45 @@ void *run_list(int box,size_t size);
 void place(void *bp, size_t asize);
 int in_free_list(void *bp);
 
+/*
+ * Allocator statistics. The event counters are cheap increments on the
+ * allocation paths and can be compiled out with -DMM_STATS=0; the heap
+ * and free list figures are computed by mm_stats() when it is called.
+ */
+#ifndef MM_STATS
+#define MM_STATS 1
+#endif
+
+#define MM_NBOXES 16 /* number of boxes in the segregated free list */
+
+typedef struct {
+    /* event counters since the last mm_init (zero if MM_STATS is 0) */
+    unsigned long malloc_calls;  /* mm_malloc calls, including from realloc */
+    unsigned long free_calls;    /* mm_free calls, including from realloc */
+    unsigned long realloc_calls; /* mm_realloc calls */
+    unsigned long sbrk_calls;    /* successful mem_sbrk calls */
+    unsigned long sbrk_bytes;    /* bytes obtained through mem_sbrk */
+    unsigned long splits;        /* free blocks split on placement */
+    unsigned long coalesces;     /* neighbouring free blocks merged */
+    unsigned long realloc_inplace; /* reallocs resized without moving data */
+    unsigned long realloc_moves;   /* reallocs slid into the previous block */
+    unsigned long realloc_copies;  /* reallocs copied to a new block */
+    unsigned long realloc_copy_bytes; /* bytes moved or copied by realloc */
+
+    /* heap state at the time of the mm_stats call */
+    size_t heap_bytes;           /* current heap size */
+    size_t inuse_blocks;         /* allocated blocks */
+    size_t inuse_bytes;          /* bytes in allocated blocks (with tags) */
+    size_t free_blocks;          /* free blocks */
+    size_t free_bytes;           /* bytes in free blocks */
+    size_t largest_free;         /* size of the largest free block */
+    double frag;                 /* 1 - largest_free/free_bytes */
+    size_t box_blocks[MM_NBOXES]; /* free blocks in each box */
+    size_t box_bytes[MM_NBOXES];  /* free bytes in each box */
+} mm_stats_t;
+
+void mm_stats(mm_stats_t *stats);
+
 
 /* 
  * Students work in teams of one or two.  Teams enter their team name, 
@@ -31,3 +79,36 @@ typedef struct {
 
 extern team_t team;
 
+/*
+ * Heap walking. mm_heap_walk calls fn for every block from the lowest
+ * address up; mm_heap_snapshot writes the blocks to fp in the format
+ * described in heapsnap.h and returns -1 if the write failed.
+ */
+typedef void (*mm_walk_fn)(void *bp, size_t size, int alloc, void *arg);
+
+void mm_heap_walk(mm_walk_fn fn, void *arg);
+int mm_heap_snapshot(FILE *fp);
+
+/*
+ * Movable allocations. A handle names a block that mm_compact may slide
+ * toward the start of the heap, so mm_hderef's address is only good until
+ * the next mm_compact unless the handle is pinned. mm_compact then gives
+ * the free space at the top of the heap back and returns its size in
+ * bytes. mm_halloc returns 0, never a valid handle, when out of memory
+ * or when size is too large. Like free(NULL), mm_hfree(0) does nothing,
+ * and mm_hderef(0) is NULL.
+ */
+typedef unsigned int mm_handle_t;
+
+mm_handle_t mm_halloc(size_t size);
+void *mm_hderef(mm_handle_t h);
+void mm_hfree(mm_handle_t h);
+void mm_hpin(mm_handle_t h);
+void mm_hunpin(mm_handle_t h);
+size_t mm_compact(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MM_H_ */
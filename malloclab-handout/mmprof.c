@@ -0,0 +1,299 @@
+/*
+ * mmprof.c - Sampling heap profiler for the mm malloc package
+ *
+ * Samples are chosen with exponentially distributed gaps between them,
+ * measured in allocated bytes, which is what pprof assumes when it
+ * scales the counts of a heap_v2 profile back up. Each sample is
+ * charged to a bucket holding its call stack. The tables live in
+ * memory obtained straight from mmap so that recording a sample never
+ * re-enters malloc; when a table is full further samples are dropped.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <execinfo.h>
+#include <sys/mman.h>
+
+#include "mmprof.h"
+
+#define MAXDEPTH    32        /* deepest call stack recorded */
+#define SKIPFRAMES   2        /* mm_prof_record and mm_malloc/mm_realloc */
+#define NBUCKETS  4096        /* distinct call stacks (power of 2) */
+#define NSAMPLES  (1<<16)     /* live samples (power of 2) */
+
+/* All samples taken with the same call stack */
+typedef struct {
+	unsigned hash;            /* hash of pcs, 0 if the bucket is unused */
+	int depth;                /* number of entries in pcs */
+	void *pcs[MAXDEPTH];      /* return addresses, innermost first */
+	long alloc_count;         /* samples taken since the last reset */
+	long long alloc_bytes;
+	long live_count;          /* samples not freed yet */
+	long long live_bytes;
+} bucket_t;
+
+/* A sampled block that has not been freed yet */
+typedef struct {
+	void *bp;                 /* block pointer, NULL if the slot is empty */
+	size_t size;              /* requested size */
+	int bucket;               /* index into buckets */
+} sample_t;
+
+size_t mm_prof_interval = 0;
+long mm_prof_countdown = 0;
+
+static bucket_t *buckets = NULL;
+static sample_t *samples = NULL;
+static unsigned rng_state = 88172645;
+static long nlive = 0;        /* occupied slots in samples */
+static long dropped = 0;      /* samples lost because a table was full */
+
+/*
+ * next_gap - Draw the number of bytes until the next sample from an
+ *     exponential distribution with mean mm_prof_interval
+ */
+static long next_gap(void)
+{
+	double u;
+
+	/* xorshift32 */
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 17;
+	rng_state ^= rng_state << 5;
+	u = (rng_state + 1.0) / 4294967297.0; /* in (0,1) */
+	return (long)(-log(u) * (double)mm_prof_interval) + 1;
+}
+
+/*
+ * table_alloc - Get zeroed memory for a table without calling malloc
+ */
+static void *table_alloc(size_t bytes)
+{
+	void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	return (p == MAP_FAILED) ? NULL : p;
+}
+
+/*
+ * mm_prof_set_interval - Sample on average one allocation every
+ *     interval bytes; 0 turns sampling off
+ */
+void mm_prof_set_interval(size_t interval)
+{
+	void *pcs[1];
+
+	if (interval != 0 && buckets == NULL) {
+		buckets = table_alloc(NBUCKETS * sizeof(bucket_t));
+		samples = table_alloc(NSAMPLES * sizeof(sample_t));
+		if (buckets == NULL || samples == NULL) {
+			fprintf(stderr, "mm_prof_set_interval: mmap failed\n");
+			return;
+		}
+		/* backtrace can allocate on its first call; do that here */
+		backtrace(pcs, 1);
+	}
+	mm_prof_interval = interval;
+	mm_prof_countdown = (interval == 0) ? 0 : next_gap();
+}
+
+/*
+ * mm_prof_reset - Forget every sample and bucket
+ */
+void mm_prof_reset(void)
+{
+	if (buckets == NULL)
+		return;
+	memset(buckets, 0, NBUCKETS * sizeof(bucket_t));
+	memset(samples, 0, NSAMPLES * sizeof(sample_t));
+	nlive = 0;
+	dropped = 0;
+	if (mm_prof_interval != 0)
+		mm_prof_countdown = next_gap();
+}
+
+/*
+ * find_bucket - Return the bucket for a call stack, creating it if
+ *     needed, or -1 if the table is full
+ */
+static int find_bucket(void **pcs, int depth)
+{
+	unsigned hash = 2166136261u;
+	int i, b;
+
+	for (i = 0; i < depth; i++)
+		hash = (hash ^ (unsigned)(size_t)pcs[i]) * 16777619u;
+	if (hash == 0)
+		hash = 1;
+
+	for (i = 0; i < NBUCKETS; i++) {
+		b = (hash + i) & (NBUCKETS - 1);
+		if (buckets[b].hash == 0) {
+			buckets[b].hash = hash;
+			buckets[b].depth = depth;
+			memcpy(buckets[b].pcs, pcs, depth * sizeof(void *));
+			return b;
+		}
+		if (buckets[b].hash == hash && buckets[b].depth == depth &&
+				!memcmp(buckets[b].pcs, pcs, depth * sizeof(void *)))
+			return b;
+	}
+	return -1;
+}
+
+/* Home slot of a block pointer in the samples table */
+#define SAMPLE_SLOT(bp) ((((size_t)(bp)) >> 3) * 2654435761u & (NSAMPLES - 1))
+
+/*
+ * mm_prof_record - Charge the block at bp to the stack of its caller.
+ *     Returns 1 if the block is now tracked.
+ */
+int mm_prof_record(void *bp, size_t size)
+{
+	void *pcs[MAXDEPTH + SKIPFRAMES];
+	int depth, b, i;
+	size_t s;
+
+	mm_prof_countdown = next_gap();
+
+	depth = backtrace(pcs, MAXDEPTH + SKIPFRAMES) - SKIPFRAMES;
+	if (depth < 0)
+		depth = 0;
+	/* The samples table is never allowed to fill completely */
+	if (nlive >= NSAMPLES / 2 ||
+			(b = find_bucket(pcs + SKIPFRAMES, depth)) < 0) {
+		dropped++;
+		return 0;
+	}
+
+	/* Linear probing from the home slot */
+	s = SAMPLE_SLOT(bp);
+	for (i = 0; i < NSAMPLES; i++, s = (s + 1) & (NSAMPLES - 1)) {
+		if (samples[s].bp == NULL) {
+			nlive++;
+			samples[s].bp = bp;
+			samples[s].size = size;
+			samples[s].bucket = b;
+			buckets[b].alloc_count++;
+			buckets[b].alloc_bytes += size;
+			buckets[b].live_count++;
+			buckets[b].live_bytes += size;
+			return 1;
+		}
+	}
+	dropped++;
+	return 0;
+}
+
+/*
+ * mm_prof_forget - Remove the sampled block at bp from the live profile
+ */
+void mm_prof_forget(void *bp)
+{
+	size_t s, next, home;
+	bucket_t *bk;
+
+	if (samples == NULL)
+		return;
+	for (s = SAMPLE_SLOT(bp); samples[s].bp != bp;
+			s = (s + 1) & (NSAMPLES - 1))
+		if (samples[s].bp == NULL)
+			return;
+
+	nlive--;
+	bk = &buckets[samples[s].bucket];
+	bk->live_count--;
+	bk->live_bytes -= samples[s].size;
+
+	/* Backward-shift deletion keeps every probe sequence unbroken */
+	next = s;
+	for (;;) {
+		samples[s].bp = NULL;
+		do {
+			next = (next + 1) & (NSAMPLES - 1);
+			if (samples[next].bp == NULL)
+				return;
+			home = SAMPLE_SLOT(samples[next].bp);
+		} while ((s <= next) ? (s < home && home <= next)
+				: (s < home || home <= next));
+		samples[s] = samples[next];
+		s = next;
+	}
+}
+
+/*
+ * mm_prof_move - The sampled block at old has been moved to new
+ */
+void mm_prof_move(void *old, void *new)
+{
+	sample_t moved;
+	size_t s;
+	int i;
+
+	if (samples == NULL)
+		return;
+	for (s = SAMPLE_SLOT(old); samples[s].bp != old;
+			s = (s + 1) & (NSAMPLES - 1))
+		if (samples[s].bp == NULL)
+			return;
+	moved = samples[s];
+	mm_prof_forget(old);
+
+	moved.bp = new;
+	s = SAMPLE_SLOT(new);
+	for (i = 0; i < NSAMPLES; i++, s = (s + 1) & (NSAMPLES - 1)) {
+		if (samples[s].bp == NULL) {
+			nlive++;
+			samples[s] = moved;
+			buckets[moved.bucket].live_count++;
+			buckets[moved.bucket].live_bytes += moved.size;
+			return;
+		}
+	}
+}
+
+/*
+ * mm_prof_dump - Write the profile in the legacy pprof heap format:
+ *     live objects and bytes, then cumulative ones in brackets, then
+ *     the call stack, one line per bucket, followed by the mappings
+ *     pprof needs to symbolize the addresses.
+ */
+int mm_prof_dump(FILE *fp)
+{
+	long live_count = 0, alloc_count = 0;
+	long long live_bytes = 0, alloc_bytes = 0;
+	FILE *maps;
+	char line[1024];
+	int b, i;
+
+	for (b = 0; buckets != NULL && b < NBUCKETS; b++) {
+		live_count += buckets[b].live_count;
+		live_bytes += buckets[b].live_bytes;
+		alloc_count += buckets[b].alloc_count;
+		alloc_bytes += buckets[b].alloc_bytes;
+	}
+	fprintf(fp, "heap profile: %6ld: %8lld [%6ld: %8lld] @ heap_v2/%lu\n",
+			live_count, live_bytes, alloc_count, alloc_bytes,
+			(unsigned long)mm_prof_interval);
+
+	for (b = 0; buckets != NULL && b < NBUCKETS; b++) {
+		if (buckets[b].alloc_count == 0)
+			continue;
+		fprintf(fp, "%6ld: %8lld [%6ld: %8lld] @",
+				buckets[b].live_count, buckets[b].live_bytes,
+				buckets[b].alloc_count, buckets[b].alloc_bytes);
+		for (i = 0; i < buckets[b].depth; i++)
+			fprintf(fp, " %p", buckets[b].pcs[i]);
+		fprintf(fp, "\n");
+	}
+	if (dropped)
+		fprintf(stderr, "mm_prof_dump: %ld samples were dropped\n", dropped);
+
+	fprintf(fp, "\nMAPPED_LIBRARIES:\n");
+	if ((maps = fopen("/proc/self/maps", "r")) != NULL) {
+		while (fgets(line, sizeof(line), maps) != NULL)
+			fputs(line, fp);
+		fclose(maps);
+	}
+	return ferror(fp) ? -1 : 0;
+}
@@ -0,0 +1,32 @@
+/*
+ * mmprof.h - Sampling heap profiler for the mm malloc package
+ *
+ * When a sampling interval is set, mm_malloc samples on average one
+ * allocation every interval bytes, records the call stack that asked
+ * for it and tracks the sample until mm_free. mm_prof_dump writes the
+ * samples grouped by call site in the text heap profile format that
+ * pprof reads, with both live and cumulative totals.
+ */
+#include <stdio.h>
+
+/* Checked inline by mm.c so that sampling costs one test when it is off */
+extern size_t mm_prof_interval; /* mean bytes between samples, 0 = off */
+extern long mm_prof_countdown;  /* bytes left before the next sample */
+
+/* Start sampling every interval bytes on average, or stop if 0 */
+void mm_prof_set_interval(size_t interval);
+
+/* Forget every sample, e.g. because the heap was reset */
+void mm_prof_reset(void);
+
+/* Record the block at bp (called by mm.c); returns 1 if it is tracked */
+int mm_prof_record(void *bp, size_t size);
+
+/* Stop tracking the sampled block at bp (called by mm.c) */
+void mm_prof_forget(void *bp);
+
+/* The sampled block at old now starts at new (called by mm_compact) */
+void mm_prof_move(void *old, void *new);
+
+/* Write the profile in pprof's heap format; returns -1 on error */
+int mm_prof_dump(FILE *fp);
@@ -0,0 +1,116 @@
+/*
+ * mmregion.c - Regions (arenas) on top of the mm malloc package (see
+ *     mmregion.h)
+ *
+ * Every chunk starts with a link to the chunk obtained before it. The
+ * region itself lives in its first chunk, right after the link, so a
+ * region costs no allocation of its own.
+ */
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "mm.h"
+#include "mmregion.h"
+
+#define ALIGNMENT 8
+#define ALIGN(size) (((size) + (ALIGNMENT - 1)) & ~(size_t)(ALIGNMENT - 1))
+
+typedef struct chunk {
+	struct chunk *prev;       /* chunk obtained before this one */
+} chunk_t;
+
+#define CHUNK_HDR ALIGN(sizeof(chunk_t))
+
+/* Largest size that still fits a chunk after aligning and the header */
+#define MAX_SIZE (SIZE_MAX - CHUNK_HDR - ALIGNMENT)
+
+struct mm_region {
+	char *next;               /* first free byte of the current chunk */
+	char *end;                /* end of the current chunk */
+	size_t chunk;             /* size of the next chunk */
+	chunk_t *chunks;          /* most recent chunk */
+};
+
+/*
+ * new_chunk - Get a chunk with room for size bytes and link it in
+ */
+static char *new_chunk(mm_region_t *r, size_t size)
+{
+	chunk_t *c;
+
+	if (size > MAX_SIZE || (c = mm_malloc(CHUNK_HDR + size)) == NULL)
+		return NULL;
+	c->prev = r->chunks;
+	r->chunks = c;
+	return (char *)c + CHUNK_HDR;
+}
+
+/*
+ * mm_region_create - Make a region whose first chunk is chunk bytes
+ */
+mm_region_t *mm_region_create(size_t chunk)
+{
+	mm_region_t boot, *r;
+	char *p;
+
+	if (chunk == 0)
+		chunk = MM_REGION_CHUNK;
+	if (chunk > MAX_SIZE)
+		return NULL;
+	chunk = ALIGN(chunk);
+	if (chunk < ALIGN(sizeof(mm_region_t)) + ALIGNMENT)
+		chunk = ALIGN(sizeof(mm_region_t)) + ALIGNMENT;
+	boot.chunks = NULL;
+	if ((p = new_chunk(&boot, chunk)) == NULL)
+		return NULL;
+	r = (mm_region_t *)p;
+	r->chunks = boot.chunks;
+	r->next = p + ALIGN(sizeof(mm_region_t));
+	r->end = p + chunk;
+	r->chunk = (chunk < MM_REGION_MAXCHUNK) ? 2 * chunk : chunk;
+	return r;
+}
+
+/*
+ * mm_region_alloc - Bump-allocate size bytes, starting a new chunk when
+ *     the current one is full
+ */
+void *mm_region_alloc(mm_region_t *r, size_t size)
+{
+	char *p;
+
+	if (size > MAX_SIZE)
+		return NULL;
+	size = ALIGN(size ? size : 1);
+	if (size <= (size_t)(r->end - r->next)) {
+		p = r->next;
+		r->next += size;
+		return p;
+	}
+
+	/* A large object gets its own chunk and the current one stays */
+	if (size > r->chunk / 4)
+		return new_chunk(r, size);
+
+	if ((p = new_chunk(r, r->chunk)) == NULL)
+		return NULL;
+	r->next = p + size;
+	r->end = p + r->chunk;
+	if (r->chunk < MM_REGION_MAXCHUNK)
+		r->chunk *= 2;
+	return p;
+}
+
+/*
+ * mm_region_release - Free every chunk, the region's own last
+ */
+void mm_region_release(mm_region_t *r)
+{
+	chunk_t *c = r->chunks, *prev;
+
+	while (c != NULL) {
+		prev = c->prev;
+		mm_free(c);
+		c = prev;
+	}
+}
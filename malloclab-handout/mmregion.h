@@ -0,0 +1,39 @@
+/*
+ * mmregion.h - Regions (arenas) on top of the mm malloc package
+ *
+ * A region hands out memory by bumping a pointer through chunks it gets
+ * from mm_malloc, and everything allocated from it is freed at once by
+ * mm_region_release, with one mm_free per chunk. Objects cannot be freed
+ * on their own. Chunks start at the size given to mm_region_create and
+ * double up to MM_REGION_MAXCHUNK; a request larger than a quarter of
+ * the size the next chunk would have gets a chunk of its own.
+ */
+#ifndef __MMREGION_H_
+#define __MMREGION_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MM_REGION_CHUNK    4096       /* first chunk if create is given 0 */
+#define MM_REGION_MAXCHUNK (1 << 18)  /* chunks stop doubling here */
+
+typedef struct mm_region mm_region_t;
+
+/* Returns NULL if chunk is too large or mm_malloc fails */
+mm_region_t *mm_region_create(size_t chunk);
+
+/* Returns 8-byte aligned memory, or NULL if size is too large or
+   mm_malloc fails */
+void *mm_region_alloc(mm_region_t *r, size_t size);
+
+/* Free every object of the region and the region itself */
+void mm_region_release(mm_region_t *r);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MMREGION_H_ */
@@ -0,0 +1,115 @@
+/*
+ * mmresource.hpp - C++ adaptors over the mm malloc package
+ *
+ * mm_resource is a std::pmr::memory_resource for the pmr containers, and
+ * mm_allocator<T> a std::allocator replacement for the others; both take
+ * their memory from mm_malloc, or mm_memalign for alignments above 8.
+ * mm.c finds a block's size in its header, so the size passed to
+ * deallocate is only checked against it, in builds without NDEBUG.
+ * The heap must have been set up with mem_init and mm_init first.
+ *
+ *	std::pmr::vector<int> v(mm_default_resource());
+ *	std::map<int, int, std::less<int>,
+ *		mm_allocator<std::pair<const int, int>>> m;
+ */
+#ifndef __MMRESOURCE_HPP_
+#define __MMRESOURCE_HPP_
+
+#include <cassert>
+#include <cstddef>
+#include <limits>
+#include <memory_resource>
+#include <new>
+
+#include "mm.h"
+
+/* mm.c aligns every block to this */
+#define MM_RESOURCE_ALIGN 8
+
+/*
+ * mm_allocate, mm_deallocate - The calls both adaptors make
+ */
+inline void *mm_allocate(std::size_t bytes, std::size_t align)
+{
+	void *p;
+
+	if (bytes == 0)
+		bytes = 1;
+	if (align <= MM_RESOURCE_ALIGN)
+		p = mm_malloc(bytes);
+	else
+		p = mm_memalign(align, bytes);
+	if (p == NULL)
+		throw std::bad_alloc();
+	return p;
+}
+
+inline void mm_deallocate(void *p, std::size_t bytes)
+{
+	assert(bytes <= mm_usable_size(p));
+	(void)bytes;
+	mm_free(p);
+}
+
+class mm_resource : public std::pmr::memory_resource {
+protected:
+	void *do_allocate(std::size_t bytes, std::size_t align) override
+	{
+		return mm_allocate(bytes, align);
+	}
+
+	void do_deallocate(void *p, std::size_t bytes, std::size_t) override
+	{
+		mm_deallocate(p, bytes);
+	}
+
+	/* There is one heap, so any two mm_resources can free each other's */
+	bool do_is_equal(const std::pmr::memory_resource &other) const
+		noexcept override
+	{
+		return dynamic_cast<const mm_resource *>(&other) != nullptr;
+	}
+};
+
+/*
+ * mm_default_resource - The mm_resource shared by the whole program
+ */
+inline mm_resource *mm_default_resource()
+{
+	static mm_resource resource;
+	return &resource;
+}
+
+template <class T>
+struct mm_allocator {
+	typedef T value_type;
+
+	mm_allocator() noexcept {}
+	template <class U> mm_allocator(const mm_allocator<U> &) noexcept {}
+
+	T *allocate(std::size_t n)
+	{
+		if (n > std::numeric_limits<std::size_t>::max() / sizeof(T))
+			throw std::bad_array_new_length();
+		return static_cast<T *>(mm_allocate(n * sizeof(T), alignof(T)));
+	}
+
+	void deallocate(T *p, std::size_t n) noexcept
+	{
+		mm_deallocate(p, n * sizeof(T));
+	}
+};
+
+template <class T, class U>
+bool operator==(const mm_allocator<T> &, const mm_allocator<U> &) noexcept
+{
+	return true;
+}
+
+template <class T, class U>
+bool operator!=(const mm_allocator<T> &, const mm_allocator<U> &) noexcept
+{
+	return false;
+}
+
+#endif /* __MMRESOURCE_HPP_ */
@@ -0,0 +1,210 @@
+/*
+ * mmshim.c - Exports the C allocation functions on top of mm.c so that
+ *     real programs can be run under the allocator:
+ *
+ *	unix> LD_PRELOAD=./libmm.so cc -O2 -c big.c
+ *
+ * The heap comes from osmemlib.c and is set up on the first call. mm.c
+ * is not thread safe, so every call holds one global lock. Pointers that
+ * were not handed out by mm.c (anything outside the heap) are ignored
+ * by free; realloc and malloc_usable_size cannot size them and abort.
+ *
+ * mm.c aligns blocks to 8 bytes, but compilers assume malloc returns
+ * memory aligned for any type (16 bytes on x86-64), so every block is
+ * allocated with mm_memalign.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "mm.h"
+#include "memlib.h"
+
+#define SHIM_EXPORT __attribute__((visibility("default")))
+#define SHIM_ALIGN  _Alignof(max_align_t)
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static int ready;  /* mm_init has been called */
+
+/*
+ * shim_fatal - Report an error without going through stdio and abort
+ */
+static void shim_fatal(const char *msg)
+{
+	ssize_t rc = write(2, msg, strlen(msg));
+
+	(void)rc;
+	abort();
+}
+
+/*
+ * The lock is held across fork so the child does not inherit it locked
+ */
+static void shim_prefork(void)  { pthread_mutex_lock(&lock); }
+static void shim_postfork(void) { pthread_mutex_unlock(&lock); }
+
+/*
+ * shim_setup - Registered at load time rather than in shim_lock, since
+ *     pthread_atfork may itself call malloc
+ */
+__attribute__((constructor)) static void shim_setup(void)
+{
+	pthread_atfork(shim_prefork, shim_postfork, shim_postfork);
+}
+
+/*
+ * shim_lock - Take the lock, setting up the heap on the first call
+ */
+static void shim_lock(void)
+{
+	pthread_mutex_lock(&lock);
+	if (!ready) {
+		mem_init();
+		if (mm_init() < 0)
+			shim_fatal("libmm: mm_init failed\n");
+		ready = 1;
+	}
+}
+
+/*
+ * in_heap - Was p handed out by mm.c?
+ */
+static int in_heap(void *p)
+{
+	return (char *)p > (char *)mem_heap_lo() && (char *)p <= (char *)mem_heap_hi();
+}
+
+SHIM_EXPORT void *malloc(size_t size)
+{
+	void *p;
+
+	shim_lock();
+	/* mm_malloc(0) fails, but malloc(0) must return a unique pointer */
+	p = mm_memalign(SHIM_ALIGN, size ? size : 1);
+	pthread_mutex_unlock(&lock);
+	if (p == NULL)
+		errno = ENOMEM;
+	return p;
+}
+
+SHIM_EXPORT void free(void *ptr)
+{
+	if (ptr == NULL)
+		return;
+	shim_lock();
+	if (in_heap(ptr))
+		mm_free(ptr);
+	pthread_mutex_unlock(&lock);
+}
+
+SHIM_EXPORT void *calloc(size_t nmemb, size_t size)
+{
+	void *p;
+	size_t total;
+
+	if (size && nmemb > (size_t)-1 / size) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	total = nmemb * size;
+	/* Not malloc then memset: the compiler would turn that into calloc */
+	shim_lock();
+	p = mm_memalign(SHIM_ALIGN, total ? total : 1);
+	pthread_mutex_unlock(&lock);
+	if (p == NULL)
+		errno = ENOMEM;
+	else
+		memset(p, 0, total);
+	return p;
+}
+
+SHIM_EXPORT void *realloc(void *ptr, size_t size)
+{
+	void *p, *q;
+
+	if (ptr == NULL)
+		return malloc(size);
+	if (size == 0) {
+		free(ptr);
+		return NULL;
+	}
+	shim_lock();
+	if (!in_heap(ptr))
+		shim_fatal("libmm: realloc of a block not from mm_malloc\n");
+	if ((p = mm_realloc(ptr, size)) != NULL && ((size_t)p & (SHIM_ALIGN - 1))) {
+		/*
+		 * Moved to a block that is not aligned enough. ptr is gone by
+		 * now, so if no aligned block is left the data stays in p,
+		 * which is only 8-byte aligned, rather than being lost.
+		 */
+		if ((q = mm_memalign(SHIM_ALIGN, size)) != NULL) {
+			memcpy(q, p, size);
+			mm_free(p);
+			p = q;
+		}
+	}
+	pthread_mutex_unlock(&lock);
+	if (p == NULL)
+		errno = ENOMEM;
+	return p;
+}
+
+SHIM_EXPORT int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+	void *p;
+
+	if (alignment < sizeof(void *) || (alignment & (alignment - 1)))
+		return EINVAL;
+	if (alignment < SHIM_ALIGN)
+		alignment = SHIM_ALIGN;
+	shim_lock();
+	p = mm_memalign(alignment, size ? size : 1);
+	pthread_mutex_unlock(&lock);
+	if (p == NULL)
+		return ENOMEM;
+	*memptr = p;
+	return 0;
+}
+
+SHIM_EXPORT void *memalign(size_t alignment, size_t size)
+{
+	void *p;
+	int rc;
+
+	/* memalign accepts any power of two, even one below a pointer */
+	if (alignment < sizeof(void *))
+		alignment = sizeof(void *);
+	if ((rc = posix_memalign(&p, alignment, size)) != 0) {
+		errno = rc;
+		return NULL;
+	}
+	return p;
+}
+
+SHIM_EXPORT void *aligned_alloc(size_t alignment, size_t size)
+{
+	return memalign(alignment, size);
+}
+
+SHIM_EXPORT void *valloc(size_t size)
+{
+	return memalign(getpagesize(), size);
+}
+
+SHIM_EXPORT size_t malloc_usable_size(void *ptr)
+{
+	size_t size;
+
+	if (ptr == NULL)
+		return 0;
+	shim_lock();
+	if (!in_heap(ptr))
+		shim_fatal("libmm: malloc_usable_size of a block not from mm_malloc\n");
+	size = mm_usable_size(ptr);
+	pthread_mutex_unlock(&lock);
+	return size;
+}
@@ -0,0 +1,766 @@
+/*
+ * mmtrace.c - Records the malloc/free/realloc stream of a real program
+ *     as a trace that mdriver can replay:
+ *
+ *	unix> LD_PRELOAD=./libmmtrace.so MMTRACE_OUT=cc1.rep cc -O2 -c big.c
+ *	unix> mdriver -V -f cc1.rep
+ *
+ * Each thread appends fixed-size records to its own buffer; full buffers
+ * are handed to a flusher thread that writes them to an unlinked
+ * temporary file, so the program only pays for a few stores and a read
+ * of the time stamp counter per call. The counter orders the records of
+ * different threads; where the TSC is not invariant, a relaxed atomic
+ * counter does instead. At exit the log is mapped, its buffers, each
+ * sorted already, are merged, and every block is given a dense id. Every
+ * thread is numbered in the order of its first call, and the trace
+ * switches threads as described in tracefmt.h ("t <tid>" lines in .rep
+ * files), so mdriver -T can replay it concurrently. The trace is written
+ * as text, or in the binary format of tracefmt.h when MMTRACE_OUT ends
+ * in ".bin". A "%p" in MMTRACE_OUT is replaced by the process id, which
+ * keeps the traces of child processes apart; the default is
+ * "mmtrace.%p.rep".
+ *
+ * Frees of blocks allocated before the recorder started are dropped, as
+ * are blocks of more than INT_MAX bytes, which traces cannot describe.
+ * Calls made by threads that are still running when the program exits
+ * may be cut off.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <errno.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "tracefmt.h"
+#include "clock.h"
+
+#define TRACE_EXPORT __attribute__((visibility("default")))
+#define TLS __thread __attribute__((tls_model("initial-exec")))
+
+#define NRECS     4096          /* records in each thread buffer */
+#define BOOTSTRAP (64 * 1024)   /* bytes served while dlsym runs */
+
+/* One recorded call; old is the block given to realloc or free */
+typedef struct {
+	unsigned long long stamp; /* orders the calls of all threads */
+	int type;                 /* TRACEFMT_ALLOC, _FREE or _REALLOC */
+	int tid;                  /* thread that made the call */
+	void *ptr;
+	void *old;
+	size_t size;
+} rec_t;
+
+typedef struct tbuf {
+	struct tbuf *next;        /* in the flush queue or the thread list */
+	struct tbuf *tnext;
+	size_t n;                 /* records in use, stored with release */
+	rec_t recs[NRECS];
+} tbuf_t;
+
+/* The real allocator */
+static void *(*real_malloc)(size_t);
+static void (*real_free)(void *);
+static void *(*real_calloc)(size_t, size_t);
+static void *(*real_realloc)(void *, size_t);
+static int (*real_posix_memalign)(void **, size_t, size_t);
+
+static char bootstrap[BOOTSTRAP];
+static size_t bootstrap_used;
+
+static unsigned long long seq;     /* next stamp when there is no TSC */
+static int use_tsc;                /* stamp calls with an invariant TSC */
+static int nthreads;               /* threads that have made a call */
+static volatile int recording;     /* cleared at exit and in forked children */
+static int logfd = -1;             /* unlinked file holding the raw records */
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queued = PTHREAD_COND_INITIALIZER;
+static tbuf_t *queue;              /* full buffers waiting to be written */
+static tbuf_t *threads;            /* current buffer of every thread */
+static tbuf_t *spare;              /* written buffers ready for reuse */
+static int stopping;
+static pthread_t flusher;
+static pthread_key_t exit_key;
+
+static TLS tbuf_t *mybuf;
+static TLS int mytid = -1;
+static TLS unsigned long long mystamp; /* stamp of this thread's last call */
+static TLS int in_hook;            /* nonzero inside the recorder itself */
+
+/*
+ * trace_fatal - Report an error without going through stdio
+ */
+static void trace_fatal(const char *msg)
+{
+	ssize_t rc = write(2, msg, strlen(msg));
+
+	(void)rc;
+	abort();
+}
+
+/*
+ * buf_get - Take an empty buffer; buffers come from mmap, not malloc
+ */
+static tbuf_t *buf_get(void)
+{
+	tbuf_t *b;
+
+	pthread_mutex_lock(&lock);
+	if ((b = spare) != NULL)
+		spare = b->next;
+	pthread_mutex_unlock(&lock);
+	if (b == NULL) {
+		b = mmap(NULL, sizeof(tbuf_t), PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (b == MAP_FAILED)
+			trace_fatal("mmtrace: out of memory for buffers\n");
+	}
+	b->n = 0;
+	b->next = b->tnext = NULL;
+	return b;
+}
+
+/*
+ * buf_queue - Hand a buffer to the flusher, dropping it from the thread
+ *     list if it is there. Called with the lock held.
+ */
+static void buf_queue(tbuf_t *b)
+{
+	tbuf_t **pp;
+
+	for (pp = &threads; *pp != NULL; pp = &(*pp)->tnext)
+		if (*pp == b) {
+			*pp = b->tnext;
+			break;
+		}
+	b->next = queue;
+	queue = b;
+	pthread_cond_signal(&queued);
+}
+
+/*
+ * write_all - Write len bytes to the log
+ */
+static void write_all(const void *buf, size_t len)
+{
+	size_t off;
+	ssize_t n;
+
+	for (off = 0; off < len; off += n)
+		if ((n = write(logfd, (const char *)buf + off, len - off)) <= 0)
+			trace_fatal("mmtrace: write to the log failed\n");
+}
+
+/*
+ * flush_thread - Body of the flusher: write full buffers to the log,
+ *     each as its record count followed by the records
+ */
+static void *flush_thread(void *arg)
+{
+	tbuf_t *b, *next;
+	size_t n;
+
+	in_hook = 1;
+	pthread_mutex_lock(&lock);
+	for (;;) {
+		while (queue == NULL && !stopping)
+			pthread_cond_wait(&queued, &lock);
+		if (queue == NULL)
+			break;
+		b = queue;
+		queue = NULL;
+		pthread_mutex_unlock(&lock);
+		for (; b != NULL; b = next) {
+			next = b->next;
+			/* pairs with the release in record */
+			n = __atomic_load_n(&b->n, __ATOMIC_ACQUIRE);
+			write_all(&n, sizeof(n));
+			write_all(b->recs, n * sizeof(rec_t));
+			pthread_mutex_lock(&lock);
+			b->next = spare;
+			spare = b;
+			pthread_mutex_unlock(&lock);
+		}
+		pthread_mutex_lock(&lock);
+	}
+	pthread_mutex_unlock(&lock);
+	return NULL;
+}
+
+/*
+ * thread_exit - Queue the buffer of an exiting thread
+ */
+static void thread_exit(void *arg)
+{
+	pthread_mutex_lock(&lock);
+	buf_queue((tbuf_t *)arg);
+	pthread_mutex_unlock(&lock);
+	mybuf = NULL;
+}
+
+/*
+ * stamp - Order key of a call. read_counter fences the TSC read behind
+ *     the code before it, so a free stamped before the real free precedes
+ *     a malloc on another core that gets the block back. Stamps of one
+ *     thread always increase, so each buffer is sorted.
+ */
+static unsigned long long stamp(void)
+{
+	unsigned long long t;
+
+	if (use_tsc)
+		t = read_counter();
+	else
+		t = __atomic_fetch_add(&seq, 1, __ATOMIC_RELAXED);
+	if (t <= mystamp)
+		t = mystamp + 1;
+	return mystamp = t;
+}
+
+/*
+ * record - Append one call to this thread's buffer
+ */
+static void record(int type, void *ptr, void *old, size_t size)
+{
+	rec_t *r;
+	size_t n;
+
+	if (!recording || in_hook)
+		return;
+	in_hook = 1;
+	if (mytid < 0)
+		mytid = __sync_fetch_and_add(&nthreads, 1);
+	if (mybuf == NULL) {
+		mybuf = buf_get();
+		pthread_mutex_lock(&lock);
+		mybuf->tnext = threads;
+		threads = mybuf;
+		pthread_mutex_unlock(&lock);
+		pthread_setspecific(exit_key, mybuf);
+	}
+	n = mybuf->n;
+	r = &mybuf->recs[n];
+	r->stamp = stamp();
+	r->type = type;
+	r->tid = mytid;
+	r->ptr = ptr;
+	r->old = old;
+	r->size = size;
+	/* Publish the record to a flusher that takes the buffer at exit */
+	__atomic_store_n(&mybuf->n, n + 1, __ATOMIC_RELEASE);
+	if (n + 1 == NRECS) {
+		pthread_mutex_lock(&lock);
+		buf_queue(mybuf);
+		pthread_mutex_unlock(&lock);
+		mybuf = buf_get();
+		pthread_mutex_lock(&lock);
+		mybuf->tnext = threads;
+		threads = mybuf;
+		pthread_mutex_unlock(&lock);
+		pthread_setspecific(exit_key, mybuf);
+	}
+	in_hook = 0;
+}
+
+/*
+ * stop_child - A forked child shares the log with its parent, so it
+ *     does not record
+ */
+static void stop_child(void)
+{
+	recording = 0;
+}
+
+/*
+ * trace_init - Find the real allocator and start the flusher
+ */
+__attribute__((constructor)) static void trace_init(void)
+{
+	char path[] = "/tmp/mmtrace.XXXXXX";
+
+	in_hook = 1;
+	use_tsc = tsc_invariant();
+	real_malloc = dlsym(RTLD_NEXT, "malloc");
+	real_free = dlsym(RTLD_NEXT, "free");
+	real_calloc = dlsym(RTLD_NEXT, "calloc");
+	real_realloc = dlsym(RTLD_NEXT, "realloc");
+	real_posix_memalign = dlsym(RTLD_NEXT, "posix_memalign");
+	if (!real_malloc || !real_free || !real_calloc || !real_realloc)
+		trace_fatal("mmtrace: cannot find the real allocator\n");
+
+	if ((logfd = mkstemp(path)) < 0)
+		trace_fatal("mmtrace: cannot create the log\n");
+	unlink(path);
+	pthread_key_create(&exit_key, thread_exit);
+	pthread_atfork(NULL, NULL, stop_child);
+	if (pthread_create(&flusher, NULL, flush_thread, NULL) != 0)
+		trace_fatal("mmtrace: cannot start the flusher\n");
+	recording = 1;
+	in_hook = 0;
+}
+
+/*********************************************************************
+ * Converting the log to a trace
+ *********************************************************************/
+
+/* Live block of the program, keyed by address */
+typedef struct {
+	void *ptr;                 /* NULL if the slot is empty */
+	int id;
+	size_t size;
+} live_t;
+
+static live_t *live;
+static size_t live_mask, live_count;
+
+#define LIVE_HOME(p) ((((size_t)(p) >> 4) * 11400714819323198485ull) & live_mask)
+
+/*
+ * live_find - Slot of ptr, or the empty slot where it would go
+ */
+static live_t *live_find(void *ptr)
+{
+	size_t s;
+
+	for (s = LIVE_HOME(ptr); live[s].ptr != NULL; s = (s + 1) & live_mask)
+		if (live[s].ptr == ptr)
+			return &live[s];
+	return &live[s];
+}
+
+/*
+ * live_add - Start tracking ptr, doubling the table when it is half full
+ */
+static void live_add(void *ptr, int id, size_t size)
+{
+	live_t *old = live, *l;
+	size_t i, oldsize = live_mask + 1;
+
+	if (2 * (live_count + 1) > live_mask + 1) {
+		live_mask = 2 * oldsize - 1;
+		if ((live = real_calloc(live_mask + 1, sizeof(live_t))) == NULL)
+			trace_fatal("mmtrace: out of memory\n");
+		for (i = 0; i < oldsize; i++)
+			if (old[i].ptr != NULL)
+				*live_find(old[i].ptr) = old[i];
+		real_free(old);
+	}
+	l = live_find(ptr);
+	if (l->ptr == NULL)
+		live_count++;
+	l->ptr = ptr;
+	l->id = id;
+	l->size = size;
+}
+
+/*
+ * live_remove - Stop tracking the block in slot l, shifting later
+ *     entries back so that every probe sequence stays intact
+ */
+static void live_remove(live_t *l)
+{
+	size_t s = l - live, next = s, home;
+
+	live_count--;
+	for (;;) {
+		live[s].ptr = NULL;
+		do {
+			next = (next + 1) & live_mask;
+			if (live[next].ptr == NULL)
+				return;
+			home = LIVE_HOME(live[next].ptr);
+		} while ((s <= next) ? (s < home && home <= next)
+				: (s < home || home <= next));
+		live[s] = live[next];
+		s = next;
+	}
+}
+
+/* A buffer of the log, in stamp order */
+typedef struct {
+	const rec_t *p;            /* next record */
+	const rec_t *end;
+} run_t;
+
+static run_t *runs;            /* binary min-heap on the stamp of p */
+static size_t nruns;
+
+/*
+ * run_sift - Move the run at i down the heap to its place
+ */
+static void run_sift(size_t i)
+{
+	size_t c;
+	run_t tmp;
+
+	while ((c = 2 * i + 1) < nruns) {
+		if (c + 1 < nruns && runs[c + 1].p->stamp < runs[c].p->stamp)
+			c++;
+		if (runs[i].p->stamp <= runs[c].p->stamp)
+			break;
+		tmp = runs[i];
+		runs[i] = runs[c];
+		runs[c] = tmp;
+		i = c;
+	}
+}
+
+/*
+ * merge_start - Set up the merge of the len bytes of the mapped log
+ */
+static void merge_start(const char *log, size_t len)
+{
+	const char *p;
+	size_t n, i, max = 0;
+
+	for (p = log; p < log + len; p += sizeof(size_t) + n * sizeof(rec_t)) {
+		n = *(const size_t *)p;
+		max++;
+	}
+	if ((runs = real_malloc((max ? max : 1) * sizeof(run_t))) == NULL)
+		trace_fatal("mmtrace: out of memory\n");
+	nruns = 0;
+	for (p = log; p < log + len; p += sizeof(size_t) + n * sizeof(rec_t)) {
+		n = *(const size_t *)p;
+		if (n == 0)
+			continue;
+		runs[nruns].p = (const rec_t *)(p + sizeof(size_t));
+		runs[nruns].end = runs[nruns].p + n;
+		nruns++;
+	}
+	for (i = nruns / 2; i-- > 0; )
+		run_sift(i);
+}
+
+/*
+ * merge_next - The record with the lowest stamp left, or NULL
+ */
+static const rec_t *merge_next(void)
+{
+	const rec_t *r;
+
+	if (nruns == 0)
+		return NULL;
+	r = runs[0].p++;
+	if (runs[0].p == runs[0].end)
+		runs[0] = runs[--nruns];
+	run_sift(0);
+	return r;
+}
+
+/* Where convert writes the trace; fp is NULL while it only counts */
+typedef struct {
+	FILE *fp;
+	int binary;                /* tracefmt.h format rather than text */
+	int prev_id;               /* for tracefmt_put_op */
+	int tid;                   /* thread of the last op written */
+	unsigned long nops;
+	unsigned long dropped;     /* calls on blocks above INT_MAX bytes */
+} out_t;
+
+/*
+ * emit - Write one op, switching threads first if needed
+ */
+static void emit(out_t *o, int type, int id, size_t size, int tid)
+{
+	o->nops++;
+	if (o->fp == NULL)
+		return;
+	if (tid != o->tid) {
+		o->tid = tid;
+		if (o->binary)
+			tracefmt_put_thread(o->fp, tid);
+		else
+			fprintf(o->fp, "t %d\n", tid);
+	}
+	if (o->binary)
+		tracefmt_put_op(o->fp, &o->prev_id, type, id, (int)size);
+	else if (type == TRACEFMT_FREE)
+		fprintf(o->fp, "f %d\n", id);
+	else
+		fprintf(o->fp, "%c %d %d\n", (type == TRACEFMT_ALLOC) ? 'a' : 'r',
+				id, (int)size);
+}
+
+/*
+ * convert - Turn the records of the log, merged in stamp order, into ops
+ *     over dense ids. Blocks above INT_MAX bytes are tracked with id -1
+ *     and left out, along with every call on them.
+ */
+static void convert(out_t *o, const char *log, size_t len, tracefmt_hdr_t *hdr)
+{
+	const rec_t *r;
+	size_t inuse = 0, peak = 0;
+	live_t *l;
+	int nids = 0, id;
+
+	if ((live = real_calloc(1024, sizeof(live_t))) == NULL)
+		trace_fatal("mmtrace: out of memory\n");
+	live_mask = 1023;
+	live_count = 0;
+	o->prev_id = o->tid = 0;
+	o->nops = o->dropped = 0;
+	merge_start(log, len);
+
+	while ((r = merge_next()) != NULL) {
+		l = (r->old != NULL) ? live_find(r->old) : NULL;
+		if (l != NULL && l->ptr == NULL)
+			l = NULL;                   /* allocated before we started */
+
+		if (r->type == TRACEFMT_FREE) {
+			if (l != NULL) {
+				if (l->id >= 0)
+					emit(o, TRACEFMT_FREE, l->id, 0, r->tid);
+				inuse -= l->size;
+				live_remove(l);
+			}
+			continue;
+		}
+		if (r->type == TRACEFMT_REALLOC && l != NULL) {
+			if (r->ptr == NULL)
+				continue;                   /* failed; old block untouched */
+			if (r->size > INT_MAX) {
+				if (l->id >= 0)
+					emit(o, TRACEFMT_FREE, l->id, 0, r->tid);
+				id = -1;
+				o->dropped++;
+			}
+			else if (l->id < 0) {
+				emit(o, TRACEFMT_ALLOC, nids, r->size, r->tid);
+				id = nids++;
+			}
+			else {
+				emit(o, TRACEFMT_REALLOC, l->id, r->size, r->tid);
+				id = l->id;
+			}
+			inuse -= l->size;
+			live_remove(l);
+			live_add(r->ptr, id, (id < 0) ? 0 : r->size);
+			inuse += (id < 0) ? 0 : r->size;
+		}
+		else if (r->ptr != NULL) {
+			/*
+			 * Another thread may get a block back from a racing realloc
+			 * before the realloc is recorded; retire the stale id.
+			 */
+			l = live_find(r->ptr);
+			if (l->ptr != NULL) {
+				if (l->id >= 0)
+					emit(o, TRACEFMT_FREE, l->id, 0, r->tid);
+				inuse -= l->size;
+				live_remove(l);
+			}
+			if (r->size > INT_MAX) {
+				live_add(r->ptr, -1, 0);
+				o->dropped++;
+				continue;
+			}
+			/* mm_malloc(0) fails, so a malloc(0) is replayed as 1 byte */
+			emit(o, TRACEFMT_ALLOC, nids, r->size ? r->size : 1, r->tid);
+			live_add(r->ptr, nids++, r->size);
+			inuse += r->size;
+		}
+		if (inuse > peak)
+			peak = inuse;
+	}
+
+	hdr->sugg_heapsize = (peak > INT_MAX) ? INT_MAX : (int)peak;
+	hdr->num_ids = nids;
+	hdr->num_ops = (int)o->nops;
+	hdr->weight = 1;
+	real_free(runs);
+	real_free(live);
+}
+
+/*
+ * write_trace - Convert the log to path: once to count the ids and ops
+ *     for the header, then again to write the ops
+ */
+static void write_trace(const char *log, size_t len, const char *path)
+{
+	tracefmt_hdr_t hdr;
+	out_t out;
+
+	out.fp = NULL;
+	convert(&out, log, len, &hdr);
+	if (out.dropped > 0)
+		fprintf(stderr, "mmtrace: left out %lu calls on blocks of more "
+				"than %d bytes\n", out.dropped, INT_MAX);
+
+	if ((out.fp = fopen(path, "w")) == NULL) {
+		perror(path);
+		return;
+	}
+	out.binary = strlen(path) > 4 && !strcmp(path + strlen(path) - 4, ".bin");
+	if (out.binary)
+		tracefmt_put_hdr(out.fp, &hdr);
+	else
+		fprintf(out.fp, "%d\n%d\n%d\n%d\n", hdr.sugg_heapsize, hdr.num_ids,
+				hdr.num_ops, hdr.weight);
+	convert(&out, log, len, &hdr);
+	if (fclose(out.fp) != 0)
+		perror(path);
+}
+
+/*
+ * trace_fini - At exit, flush every buffer, map the log and write the
+ *     trace
+ */
+__attribute__((destructor)) static void trace_fini(void)
+{
+	char path[1024];
+	const char *out, *pid;
+	char *log = NULL;
+	off_t len;
+
+	if (!recording)
+		return;
+	recording = 0;
+	in_hook = 1;
+
+	pthread_mutex_lock(&lock);
+	while (threads != NULL)
+		buf_queue(threads);
+	stopping = 1;
+	pthread_cond_signal(&queued);
+	pthread_mutex_unlock(&lock);
+	pthread_join(flusher, NULL);
+
+	/* The log is read through the page cache, not copied */
+	len = lseek(logfd, 0, SEEK_END);
+	if (len > 0 && (log = mmap(NULL, len, PROT_READ, MAP_PRIVATE, logfd, 0))
+			== MAP_FAILED)
+		trace_fatal("mmtrace: cannot map the log\n");
+	if (len > 0)
+		madvise(log, len, MADV_SEQUENTIAL);
+
+	/* A %p in the name keeps the traces of child processes apart */
+	if ((out = getenv("MMTRACE_OUT")) == NULL)
+		out = "mmtrace.%p.rep";
+	if ((pid = strstr(out, "%p")) != NULL)
+		snprintf(path, sizeof(path), "%.*s%d%s", (int)(pid - out), out,
+				(int)getpid(), pid + 2);
+	else
+		snprintf(path, sizeof(path), "%s", out);
+	write_trace(log, len, path);
+	if (len > 0)
+		munmap(log, len);
+	close(logfd);
+}
+
+/*********************************************************************
+ * The interposed functions
+ *********************************************************************/
+
+/*
+ * bootstrap_alloc - dlsym can call calloc before the real one is known
+ */
+static void *bootstrap_alloc(size_t size)
+{
+	void *p;
+
+	size = (size + 15) & ~(size_t)15;
+	if (bootstrap_used + size > BOOTSTRAP)
+		return NULL;
+	p = bootstrap + bootstrap_used;
+	bootstrap_used += size;
+	return p;
+}
+
+#define IS_BOOTSTRAP(p) ((char *)(p) >= bootstrap && \
+		(char *)(p) < bootstrap + BOOTSTRAP)
+
+TRACE_EXPORT void *malloc(size_t size)
+{
+	void *p;
+
+	if (real_malloc == NULL)
+		return bootstrap_alloc(size);
+	p = real_malloc(size);
+	record(TRACEFMT_ALLOC, p, NULL, size);
+	return p;
+}
+
+TRACE_EXPORT void *calloc(size_t nmemb, size_t size)
+{
+	void *p;
+
+	if (real_calloc == NULL)
+		return bootstrap_alloc(nmemb * size);  /* static, so already zero */
+	p = real_calloc(nmemb, size);
+	record(TRACEFMT_ALLOC, p, NULL, nmemb * size);
+	return p;
+}
+
+TRACE_EXPORT void free(void *ptr)
+{
+	if (ptr == NULL || IS_BOOTSTRAP(ptr))
+		return;
+	/* Record first, so a block reused by another thread is seen later */
+	record(TRACEFMT_FREE, NULL, ptr, 0);
+	real_free(ptr);
+}
+
+TRACE_EXPORT void *realloc(void *ptr, size_t size)
+{
+	void *p;
+
+	if (real_realloc == NULL || IS_BOOTSTRAP(ptr)) {
+		/* Bootstrap blocks are small; copy what fits */
+		size_t left = IS_BOOTSTRAP(ptr) ? bootstrap + BOOTSTRAP - (char *)ptr : 0;
+
+		if ((p = (real_malloc ? malloc : bootstrap_alloc)(size)) != NULL && ptr)
+			memcpy(p, ptr, size < left ? size : left);
+		return p;
+	}
+	p = real_realloc(ptr, size);
+	if (size == 0 && ptr != NULL)
+		record(TRACEFMT_FREE, NULL, ptr, 0);
+	else
+		record(TRACEFMT_REALLOC, p, ptr, size);
+	return p;
+}
+
+TRACE_EXPORT int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+	char *p;
+	int rc;
+
+	if (real_posix_memalign == NULL) {
+		/* Serve dlsym from the bootstrap area; afterwards there is none */
+		if (alignment < sizeof(void *) || (alignment & (alignment - 1)))
+			return EINVAL;
+		if (real_malloc != NULL || size > BOOTSTRAP || alignment > BOOTSTRAP ||
+				(p = bootstrap_alloc(size + alignment)) == NULL)
+			return ENOMEM;
+		*memptr = (void *)(((size_t)p + alignment - 1) & ~(alignment - 1));
+		return 0;
+	}
+	if ((rc = real_posix_memalign(memptr, alignment, size)) == 0)
+		record(TRACEFMT_ALLOC, *memptr, NULL, size);
+	return rc;
+}
+
+TRACE_EXPORT void *memalign(size_t alignment, size_t size)
+{
+	void *p;
+	int rc;
+
+	if (alignment < sizeof(void *))
+		alignment = sizeof(void *);
+	if ((rc = posix_memalign(&p, alignment, size)) != 0) {
+		errno = rc;
+		return NULL;
+	}
+	return p;
+}
+
+TRACE_EXPORT void *aligned_alloc(size_t alignment, size_t size)
+{
+	return memalign(alignment, size);
+}
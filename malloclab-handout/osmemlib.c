@@ -0,0 +1,145 @@
+/*
+ * osmemlib.c - memlib.h backed by memory from the operating system,
+ *     used instead of memlib.c when mm.c is the real malloc (libmm.so).
+ *
+ * The whole heap is reserved with one mmap at the first mem_init and
+ * mem_sbrk hands it out from the bottom, so the heap stays contiguous as
+ * mm.c expects. The reservation is not charged to the process until
+ * pages are touched. mm.c stores free-list links as 32-bit offsets, so
+ * the heap may be anywhere in memory, but block sizes are 32-bit header
+ * words, so it must stay below 4GB.
+ *
+ * Nothing here may call malloc: this code runs inside it.
+ */
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+
+#include "memlib.h"
+
+#define OS_HEAP_MB 512    /* default reservation; MM_HEAP_MB overrides it */
+#define OS_HEAP_MAX 4095   /* largest heap mm.c's block sizes can span, in MB */
+
+/* private variables */
+static char *mem_start_brk;  /* points to first byte of heap */
+static char *mem_brk;        /* points to last byte of heap */
+static char *mem_max_addr;   /* largest legal heap address */
+
+/*
+ * mem_fatal - Report an error without going through stdio
+ */
+static void mem_fatal(const char *msg)
+{
+	ssize_t rc = write(2, msg, strlen(msg));
+
+	(void)rc;
+	_exit(1);
+}
+
+/*
+ * mem_release - Give the whole pages of [lo, hi) back to the system; they
+ *     read as zero if the heap grows over them again
+ */
+static void mem_release(char *lo, char *hi)
+{
+	size_t page = (size_t)getpagesize();
+	char *start = (char *)(((size_t)lo + page - 1) & ~(page - 1));
+
+	if (start < hi)
+		madvise(start, (size_t)(hi - start) & ~(page - 1), MADV_DONTNEED);
+}
+
+/*
+ * mem_init - reserve the address space for the heap
+ */
+void mem_init(void)
+{
+	size_t size = (size_t)OS_HEAP_MB << 20;
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+	char *env;
+
+	if (mem_start_brk != NULL)
+		return;
+	if ((env = getenv("MM_HEAP_MB")) != NULL && atoi(env) > 0) {
+		if (atoi(env) > OS_HEAP_MAX)
+			mem_fatal("mem_init: MM_HEAP_MB is larger than 4095\n");
+		size = (size_t)atoi(env) << 20;
+	}
+	mem_start_brk = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+	if (mem_start_brk == MAP_FAILED)
+		mem_fatal("mem_init: could not reserve the heap\n");
+
+	mem_max_addr = mem_start_brk + size;  /* max legal heap address */
+	mem_brk = mem_start_brk;              /* heap is empty initially */
+}
+
+/*
+ * mem_deinit - give the heap back to the system
+ */
+void mem_deinit(void)
+{
+	munmap(mem_start_brk, mem_max_addr - mem_start_brk);
+	mem_start_brk = mem_brk = mem_max_addr = NULL;
+}
+
+/*
+ * mem_reset_brk - reset the brk pointer to make an empty heap
+ */
+void mem_reset_brk()
+{
+	mem_brk = mem_start_brk;
+}
+
+/*
+ * mem_sbrk - Extends the heap by incr bytes and returns the start address
+ *    of the new area. A negative incr shrinks the heap, and the pages
+ *    given back are released to the system.
+ */
+void *mem_sbrk(int incr)
+{
+	char *old_brk = mem_brk;
+
+	if ((mem_brk + incr < mem_start_brk) || ((mem_brk + incr) > mem_max_addr)) {
+		errno = ENOMEM;
+		return (void *)-1;
+	}
+	mem_brk += incr;
+	if (incr < 0)
+		mem_release(mem_brk, old_brk);
+	return (void *)old_brk;
+}
+
+/*
+ * mem_heap_lo - return address of the first heap byte
+ */
+void *mem_heap_lo()
+{
+	return (void *)mem_start_brk;
+}
+
+/*
+ * mem_heap_hi - return address of last heap byte
+ */
+void *mem_heap_hi()
+{
+	return (void *)(mem_brk - 1);
+}
+
+/*
+ * mem_heapsize() - returns the heap size in bytes
+ */
+size_t mem_heapsize()
+{
+	return (size_t)(mem_brk - mem_start_brk);
+}
+
+/*
+ * mem_pagesize() - returns the page size of the system
+ */
+size_t mem_pagesize()
+{
+	return (size_t)getpagesize();
+}
@@ -0,0 +1,141 @@
+/*
+ * perfctr.c - Hardware performance counters (see perfctr.h)
+ *
+ * When the kernel multiplexes more events than the PMU has counters,
+ * each count is scaled by the fraction of the time it was running.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "perfctr.h"
+
+static const char *names[PC_NEVENTS] = {
+	"insns", "cycles", "L1d-miss", "LLC-miss", "dTLB-miss", "br-miss"
+};
+
+static int fds[PC_NEVENTS];
+
+#ifdef __linux__
+
+static int nopen;
+static pid_t owner;  /* process the counters were opened in */
+
+#define CACHE_READ_MISS(c) ((c) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | \
+		(PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+/*
+ * open_event - Open one disabled user-mode counter for this thread
+ */
+static int open_event(unsigned type, unsigned long long config)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+		PERF_FORMAT_TOTAL_TIME_RUNNING;
+	return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+int pc_init(void)
+{
+	int i;
+
+	if (nopen > 0 && owner == getpid())
+		return nopen;
+	/* counters follow the thread that opened them, so a child reopens */
+	for (i = 0; nopen > 0 && i < PC_NEVENTS; i++)
+		if (fds[i] >= 0)
+			close(fds[i]);
+	nopen = 0;
+	owner = getpid();
+	fds[PC_INSNS] = open_event(PERF_TYPE_HARDWARE,
+			PERF_COUNT_HW_INSTRUCTIONS);
+	fds[PC_CYCLES] = open_event(PERF_TYPE_HARDWARE,
+			PERF_COUNT_HW_CPU_CYCLES);
+	fds[PC_L1DMISS] = open_event(PERF_TYPE_HW_CACHE,
+			CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D));
+	fds[PC_LLCMISS] = open_event(PERF_TYPE_HARDWARE,
+			PERF_COUNT_HW_CACHE_MISSES);
+	fds[PC_DTLBMISS] = open_event(PERF_TYPE_HW_CACHE,
+			CACHE_READ_MISS(PERF_COUNT_HW_CACHE_DTLB));
+	fds[PC_BRMISS] = open_event(PERF_TYPE_HARDWARE,
+			PERF_COUNT_HW_BRANCH_MISSES);
+	for (i = 0; i < PC_NEVENTS; i++)
+		if (fds[i] >= 0)
+			nopen++;
+	return nopen;
+}
+
+void pc_start(void)
+{
+	int i;
+
+	if (owner != getpid())
+		pc_init();
+	for (i = 0; i < PC_NEVENTS; i++) {
+		if (fds[i] < 0)
+			continue;
+		ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+		ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+	}
+}
+
+void pc_stop(pcvals_t *v)
+{
+	unsigned long long buf[3]; /* value, time enabled, time running */
+	int i;
+
+	for (i = 0; i < PC_NEVENTS; i++)
+		if (fds[i] >= 0)
+			ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+	for (i = 0; i < PC_NEVENTS; i++) {
+		v->count[i] = -1;
+		if (fds[i] < 0 || read(fds[i], buf, sizeof(buf)) != sizeof(buf) ||
+				buf[2] == 0)
+			continue;
+		v->count[i] = (double)buf[0] * ((double)buf[1] / (double)buf[2]);
+	}
+}
+
+#else /* !__linux__ */
+
+int pc_init(void)
+{
+	int i;
+
+	for (i = 0; i < PC_NEVENTS; i++)
+		fds[i] = -1;
+	return 0;
+}
+
+void pc_start(void)
+{
+}
+
+void pc_stop(pcvals_t *v)
+{
+	int i;
+
+	for (i = 0; i < PC_NEVENTS; i++)
+		v->count[i] = -1;
+}
+
+#endif /* __linux__ */
+
+const char *pc_name(int event)
+{
+	return names[event];
+}
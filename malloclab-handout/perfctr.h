@@ -0,0 +1,37 @@
+/*
+ * perfctr.h - Hardware performance counters for the timing harness
+ *
+ * Counts the events below for the calling thread, in user mode only,
+ * using Linux perf_event_open. Each event is opened on its own so that a
+ * host missing one of them (a VM without a dTLB event, say) still
+ * reports the rest. Where the kernel or the hardware offers none of
+ * them, pc_init returns 0 and the caller goes on without counters.
+ */
+#ifndef __PERFCTR_H_
+#define __PERFCTR_H_
+
+/* The events counted, in the order they are reported */
+enum {PC_INSNS, PC_CYCLES, PC_L1DMISS, PC_LLCMISS, PC_DTLBMISS, PC_BRMISS,
+	PC_NEVENTS};
+
+/* Counts of one measurement; -1 for an event that could not be counted */
+typedef struct {
+	double count[PC_NEVENTS];
+} pcvals_t;
+
+/*
+ * Open the counters; returns how many of the events can be counted. A
+ * forked child reopens them in pc_start, to count its own events.
+ */
+int pc_init(void);
+
+/* Short column name of an event */
+const char *pc_name(int event);
+
+/* Zero the counters and start counting */
+void pc_start(void);
+
+/* Stop counting and read the counts into v */
+void pc_stop(pcvals_t *v);
+
+#endif /* __PERFCTR_H_ */
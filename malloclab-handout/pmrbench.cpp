@@ -0,0 +1,197 @@
+/*
+ * pmrbench.cpp - Times C++ container churn on mm.c and on the default
+ *     allocators (see mmresource.hpp)
+ *
+ * Each workload runs with std::allocator, mm_allocator, the default pmr
+ * resource and mm_resource, on a fresh mm heap every run, and is timed
+ * with fsecs:
+ *
+ *	vector  grow vectors of longs by push_back, then drop them
+ *	umap    insert random keys into an unordered_map, erase half, repeat
+ *	map     the same on a std::map
+ *
+ *	unix> pmrbench -n 20000
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <unistd.h>
+
+#include "mm.h"
+#include "memlib.h"
+#include "fsecs.h"
+#include "mmresource.hpp"
+#include "rng.h"
+
+#define ROUNDS 10  /* times each workload refills its container per run */
+
+/* fsecs.c, compiled as C, prints its calibration when this is set */
+extern "C" int verbose;
+int verbose = 0;
+
+/* A workload run with one allocator, for fsecs */
+struct job_t {
+	void (*run)(const void *alloc, int n);
+	const void *alloc;   /* an allocator of the type run expects */
+	int n;               /* elements per round */
+};
+
+static unsigned long long rng_state = 1;
+
+static void usage(void);
+
+/*
+ * vector_churn - Vectors grown one element at a time, each round's
+ *     vectors living until the end of the round
+ */
+template <class A>
+static void vector_churn(const void *alloc, int n)
+{
+	typedef typename std::allocator_traits<A>::template rebind_alloc<long> LA;
+	typedef std::vector<long, LA> vec_t;
+	int round, i, j;
+
+	for (round = 0; round < ROUNDS; round++) {
+		std::vector<vec_t> outer;
+		for (i = 0; i < 64; i++) {
+			outer.emplace_back(LA(*(const A *)alloc));
+			for (j = 0; j < n / 64; j++)
+				outer.back().push_back(j);
+		}
+	}
+}
+
+/*
+ * umap_churn - Random inserts into an unordered_map, half erased again
+ *     after each round
+ */
+template <class A>
+static void umap_churn(const void *alloc, int n)
+{
+	typedef std::pair<const long, long> pair_t;
+	typedef typename std::allocator_traits<A>::template rebind_alloc<pair_t> PA;
+	std::unordered_map<long, long, std::hash<long>, std::equal_to<long>, PA>
+		m(0, std::hash<long>(), std::equal_to<long>(), PA(*(const A *)alloc));
+	int round, i;
+
+	rng_state = 1;
+	for (round = 0; round < ROUNDS; round++) {
+		for (i = 0; i < n; i++)
+			m[(long)(rng_next(&rng_state) % (4ULL * n))] = i;
+		for (auto it = m.begin(); it != m.end(); )
+			it = (it->first & 1) ? m.erase(it) : std::next(it);
+	}
+}
+
+/*
+ * map_churn - umap_churn on a std::map
+ */
+template <class A>
+static void map_churn(const void *alloc, int n)
+{
+	typedef std::pair<const long, long> pair_t;
+	typedef typename std::allocator_traits<A>::template rebind_alloc<pair_t> PA;
+	std::map<long, long, std::less<long>, PA> m(std::less<long>(),
+			PA(*(const A *)alloc));
+	int round, i;
+
+	rng_state = 1;
+	for (round = 0; round < ROUNDS; round++) {
+		for (i = 0; i < n; i++)
+			m[(long)(rng_next(&rng_state) % (4ULL * n))] = i;
+		for (auto it = m.begin(); it != m.end(); )
+			it = (it->first & 1) ? m.erase(it) : std::next(it);
+	}
+}
+
+/*
+ * run_job - Run a workload on an empty mm heap
+ */
+static void run_job(void *arg)
+{
+	job_t *job = (job_t *)arg;
+
+	mem_reset_brk();
+	if (mm_init() < 0) {
+		fprintf(stderr, "pmrbench: mm_init failed\n");
+		exit(1);
+	}
+	job->run(job->alloc, job->n);
+}
+
+/*
+ * time_workload - Print the milliseconds per run of one workload with
+ *     each of the allocators
+ */
+static void time_workload(const char *name, void (*std_run)(const void *, int),
+		void (*mm_run)(const void *, int),
+		void (*pmr_run)(const void *, int), int n)
+{
+	std::allocator<char> std_alloc;
+	mm_allocator<char> mm_alloc;
+	std::pmr::polymorphic_allocator<char> def_alloc(
+			std::pmr::get_default_resource());
+	std::pmr::polymorphic_allocator<char> mmr_alloc(mm_default_resource());
+	job_t jobs[4] = {
+		{std_run, &std_alloc, n}, {mm_run, &mm_alloc, n},
+		{pmr_run, &def_alloc, n}, {pmr_run, &mmr_alloc, n},
+	};
+	int i;
+
+	printf("%-8s", name);
+	for (i = 0; i < 4; i++)
+		printf("%14.2f", fsecs(run_job, &jobs[i]) * 1e3);
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	typedef std::pmr::polymorphic_allocator<char> pmr_t;
+	int c, n = 20000;
+
+	while ((c = getopt(argc, argv, "n:h")) != EOF) {
+		switch (c) {
+			case 'n': /* Elements per round */
+				n = atoi(optarg);
+				break;
+			case 'h': /* Print this message */
+				usage();
+				exit(0);
+			default:
+				usage();
+				exit(1);
+		}
+	}
+	if (optind != argc || n < 64) {
+		usage();
+		exit(1);
+	}
+
+	mem_init();
+	init_fsecs();
+	printf("ms per run, %d elements x %d rounds\n", n, ROUNDS);
+	printf("%-8s%14s%14s%14s%14s\n", "", "std::alloc", "mm_allocator",
+			"pmr default", "mm_resource");
+	time_workload("vector", vector_churn<std::allocator<char>>,
+			vector_churn<mm_allocator<char>>, vector_churn<pmr_t>, n);
+	time_workload("umap", umap_churn<std::allocator<char>>,
+			umap_churn<mm_allocator<char>>, umap_churn<pmr_t>, n);
+	time_workload("map", map_churn<std::allocator<char>>,
+			map_churn<mm_allocator<char>>, map_churn<pmr_t>, n);
+	exit(0);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+	fprintf(stderr, "Usage: pmrbench [-h] [-n <elements>]\n");
+	fprintf(stderr, "Options\n");
+	fprintf(stderr, "\t-h             Print this message.\n");
+	fprintf(stderr, "\t-n <elements>  Elements per round of each workload (default 20000).\n");
+}
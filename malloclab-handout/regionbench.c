@@ -0,0 +1,198 @@
+/*
+ * regionbench.c - Compares per-object mm_malloc/mm_free with regions
+ *     (mmregion.h) on a request-handler workload
+ *
+ * Each simulated request allocates a batch of small objects, writes to
+ * each of them and then lets them all die together: one by one through
+ * mm_free, or at once through mm_region_release. Both paths replay the
+ * same sizes on a fresh heap and are timed with fsecs. For example
+ *
+ *	unix> regionbench -n 2000 -k 300 -s 16:512
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "mm.h"
+#include "memlib.h"
+#include "mmregion.h"
+#include "fsecs.h"
+#include "rng.h"
+
+/* The workload, shared by both paths */
+typedef struct {
+	int requests;        /* batches */
+	int objects;         /* objects per batch */
+	size_t chunk;        /* first chunk of each region, 0 for the default */
+	int *sizes;          /* requests * objects sizes */
+	void **live;         /* the objects of the current batch */
+} work_t;
+
+int verbose = 0;  /* fsecs.c's calibration messages; regionbench has no -v */
+
+static unsigned long long rng_state = 1;
+
+static void usage(void);
+
+/*
+ * start_heap - Give each timed run an empty heap
+ */
+static void start_heap(void)
+{
+	mem_reset_brk();
+	if (mm_init() < 0) {
+		fprintf(stderr, "regionbench: mm_init failed\n");
+		exit(1);
+	}
+}
+
+/*
+ * run_objects - Every object through mm_malloc and mm_free
+ */
+static void run_objects(void *arg)
+{
+	work_t *w = (work_t *)arg;
+	int *size = w->sizes;
+	int i, j;
+
+	start_heap();
+	for (i = 0; i < w->requests; i++) {
+		for (j = 0; j < w->objects; j++, size++) {
+			if ((w->live[j] = mm_malloc(*size)) == NULL) {
+				fprintf(stderr, "regionbench: mm_malloc failed\n");
+				exit(1);
+			}
+			*(char *)w->live[j] = (char)j;
+		}
+		for (j = 0; j < w->objects; j++)
+			mm_free(w->live[j]);
+	}
+}
+
+/*
+ * run_regions - One region per request, released at its end
+ */
+static void run_regions(void *arg)
+{
+	work_t *w = (work_t *)arg;
+	int *size = w->sizes;
+	mm_region_t *r;
+	char *p;
+	int i, j;
+
+	start_heap();
+	for (i = 0; i < w->requests; i++) {
+		if ((r = mm_region_create(w->chunk)) == NULL) {
+			fprintf(stderr, "regionbench: mm_region_create failed\n");
+			exit(1);
+		}
+		for (j = 0; j < w->objects; j++, size++) {
+			if ((p = mm_region_alloc(r, *size)) == NULL) {
+				fprintf(stderr, "regionbench: mm_region_alloc failed\n");
+				exit(1);
+			}
+			*p = (char)j;
+		}
+		mm_region_release(r);
+	}
+}
+
+/*
+ * report - Time one path and print a line for it
+ */
+static void report(const char *name, fsecs_test_funct f, work_t *w)
+{
+	mm_stats_t stats;
+	double secs, ops = (double)w->requests * w->objects;
+
+	/* an untimed run for the counters and the heap size */
+	f(w);
+	mm_stats(&stats);
+	secs = fsecs(f, w);
+	printf("%-10s%12.0f%12.0f%14.1f\n", name, ops / secs / 1e3,
+			mem_heapsize() / 1024.0,
+			(double)(stats.malloc_calls + stats.free_calls) / w->requests);
+}
+
+int main(int argc, char **argv)
+{
+	work_t w;
+	int c, lo = 16, hi = 256;
+	size_t i, n;
+
+	w.requests = 1000;
+	w.objects = 200;
+	w.chunk = 0;
+	while ((c = getopt(argc, argv, "n:k:s:c:S:h")) != EOF) {
+		switch (c) {
+			case 'n': /* Number of requests */
+				w.requests = atoi(optarg);
+				break;
+			case 'k': /* Objects per request */
+				w.objects = atoi(optarg);
+				break;
+			case 's': /* Object sizes */
+				if (sscanf(optarg, "%d:%d", &lo, &hi) != 2) {
+					usage();
+					exit(1);
+				}
+				break;
+			case 'c': /* First chunk of each region */
+				w.chunk = (size_t)atol(optarg);
+				break;
+			case 'S': /* Seed */
+				rng_state = strtoull(optarg, NULL, 0);
+				break;
+			case 'h': /* Print this message */
+				usage();
+				exit(0);
+			default:
+				usage();
+				exit(1);
+		}
+	}
+	if (optind != argc || w.requests <= 0 || w.objects <= 0 || lo < 1 ||
+			hi < lo) {
+		usage();
+		exit(1);
+	}
+	if (rng_state == 0)
+		rng_state = 1;
+
+	n = (size_t)w.requests * w.objects;
+	w.sizes = (int *)malloc(n * sizeof(int));
+	w.live = (void **)malloc(w.objects * sizeof(void *));
+	if (w.sizes == NULL || w.live == NULL) {
+		perror("malloc");
+		exit(1);
+	}
+	for (i = 0; i < n; i++)
+		w.sizes[i] = lo + (int)(rng_next(&rng_state) % (unsigned long long)(hi - lo + 1));
+
+	mem_init();
+	init_fsecs();
+	printf("%d requests of %d objects of %d to %d bytes\n", w.requests,
+			w.objects, lo, hi);
+	printf("%-10s%12s%12s%14s\n", "path", "Kops/sec", "heap KB",
+			"mm calls/req");
+	report("mm_malloc", run_objects, &w);
+	report("region", run_regions, &w);
+	exit(0);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+	fprintf(stderr, "Usage: regionbench [-h] [-n <requests>] [-k <objects>] [-s <lo>:<hi>]\n");
+	fprintf(stderr, "                   [-c <bytes>] [-S <seed>]\n");
+	fprintf(stderr, "Options\n");
+	fprintf(stderr, "\t-c <bytes>     First chunk of each region (default %d).\n",
+			MM_REGION_CHUNK);
+	fprintf(stderr, "\t-h             Print this message.\n");
+	fprintf(stderr, "\t-k <objects>   Objects allocated per request (default 200).\n");
+	fprintf(stderr, "\t-n <requests>  Number of requests (default 1000).\n");
+	fprintf(stderr, "\t-s <lo>:<hi>   Object sizes, uniform (default 16:256).\n");
+	fprintf(stderr, "\t-S <seed>      Seed of the random number generator (default 1).\n");
+}
@@ -0,0 +1,241 @@
+/*
+ * repconv.c - Converts traces between the .rep text format and the
+ *     binary format described in tracefmt.h
+ *
+ * The direction is chosen from the input: a text trace is encoded as
+ * binary, in the compact layout or with -F the fixed-width one, and a
+ * binary trace in either layout is decoded back to text.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "tracefmt.h"
+
+#define MAXLINE 1024
+
+static void usage(void);
+
+/*
+ * put_op - Write one op in the chosen layout
+ */
+static void put_op(FILE *outfile, int fixed, int *prev_id, int type,
+		int index, int size, int tid)
+{
+	if (fixed)
+		tracefmt_put_rec(outfile, type, index, size, tid);
+	else
+		tracefmt_put_op(outfile, prev_id, type, index, size);
+}
+
+/*
+ * rep_to_bin - Encode the text trace in infile as binary into outfile.
+ *     The fixed-width header is rewritten at the end with the number of
+ *     ops and threads found.
+ */
+static void rep_to_bin(FILE *infile, char *inpath, FILE *outfile, int fixed)
+{
+	tracefmt_hdr_t hdr;
+	char type[MAXLINE];
+	int index, size, prev_id = 0, nops = 0, tid = 0, nthreads = 1;
+
+	if (fscanf(infile, "%d %d %d %d", &hdr.sugg_heapsize, &hdr.num_ids,
+				&hdr.num_ops, &hdr.weight) != 4) {
+		fprintf(stderr, "%s: bad trace header\n", inpath);
+		exit(1);
+	}
+	if (fixed)
+		tracefmt_put_fixed_hdr(outfile, &hdr, nthreads);
+	else
+		tracefmt_put_hdr(outfile, &hdr);
+
+	while (fscanf(infile, "%s", type) != EOF) {
+		size = 0;
+		switch (type[0]) {
+			case 'a':
+			case 'r':
+				if (fscanf(infile, "%d %d", &index, &size) != 2) {
+					fprintf(stderr, "%s: bad request %d\n", inpath, nops);
+					exit(1);
+				}
+				put_op(outfile, fixed, &prev_id, (type[0] == 'a') ?
+						TRACEFMT_ALLOC : TRACEFMT_REALLOC, index, size, tid);
+				break;
+			case 'f':
+				if (fscanf(infile, "%d", &index) != 1) {
+					fprintf(stderr, "%s: bad request %d\n", inpath, nops);
+					exit(1);
+				}
+				put_op(outfile, fixed, &prev_id, TRACEFMT_FREE, index, 0, tid);
+				break;
+			case 't':
+				if (fscanf(infile, "%d", &tid) != 1 || tid < 0) {
+					fprintf(stderr, "%s: bad thread switch after op %d\n",
+							inpath, nops);
+					exit(1);
+				}
+				if (tid >= nthreads)
+					nthreads = tid + 1;
+				if (!fixed)
+					tracefmt_put_thread(outfile, tid);
+				continue;  /* not an op */
+			default:
+				fprintf(stderr, "Bogus type character (%c) in tracefile %s\n",
+						type[0], inpath);
+				exit(1);
+		}
+		nops++;
+	}
+	if (nops != hdr.num_ops)
+		fprintf(stderr, "%s: warning: header says %d ops, found %d\n",
+				inpath, hdr.num_ops, nops);
+	if (fixed) {
+		hdr.num_ops = nops;
+		if (fseek(outfile, 0, SEEK_SET) < 0) {
+			perror("fseek");
+			exit(1);
+		}
+		tracefmt_put_fixed_hdr(outfile, &hdr, nthreads);
+	}
+}
+
+/*
+ * fixed_to_rep - Write the records of a fixed-width trace as text
+ */
+static void fixed_to_rep(char *inpath, void *buf, size_t len, FILE *outfile)
+{
+	const tracefmt_rec_t *r;
+	tracefmt_hdr_t hdr;
+	int i, nthreads, tid = 0;
+
+	if ((r = tracefmt_open_fixed(buf, len, &hdr, &nthreads)) == NULL) {
+		fprintf(stderr, "%s: bad fixed-width trace header\n", inpath);
+		exit(1);
+	}
+	fprintf(outfile, "%d\n%d\n%d\n%d\n", hdr.sugg_heapsize, hdr.num_ids,
+			hdr.num_ops, hdr.weight);
+	for (i = 0; i < hdr.num_ops; i++, r++) {
+		if (r->tid != tid)
+			fprintf(outfile, "t %d\n", tid = r->tid);
+		if (r->type == TRACEFMT_FREE)
+			fprintf(outfile, "f %d\n", r->id);
+		else
+			fprintf(outfile, "%c %d %d\n",
+					(r->type == TRACEFMT_ALLOC) ? 'a' : 'r', r->id, r->size);
+	}
+}
+
+/*
+ * bin_to_rep - Decode the binary trace in inpath as text into outfile
+ */
+static void bin_to_rep(char *inpath, FILE *outfile)
+{
+	int fd, rc, type, index, size;
+	struct stat st;
+	void *buf;
+	tracefmt_hdr_t hdr;
+	tracefmt_cursor_t cur;
+
+	if ((fd = open(inpath, O_RDONLY)) < 0 || fstat(fd, &st) < 0) {
+		perror(inpath);
+		exit(1);
+	}
+	if ((buf = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0))
+			== MAP_FAILED) {
+		perror("mmap");
+		exit(1);
+	}
+	close(fd);
+
+	if (st.st_size > 4 && ((unsigned char *)buf)[4] == TRACEFMT_FIXED) {
+		fixed_to_rep(inpath, buf, st.st_size, outfile);
+		munmap(buf, st.st_size);
+		return;
+	}
+	if (tracefmt_open(&cur, buf, st.st_size, &hdr) < 0) {
+		fprintf(stderr, "%s: bad binary trace header\n", inpath);
+		exit(1);
+	}
+	fprintf(outfile, "%d\n%d\n%d\n%d\n", hdr.sugg_heapsize, hdr.num_ids,
+			hdr.num_ops, hdr.weight);
+	while ((rc = tracefmt_next(&cur, &type, &index, &size)) > 0) {
+		if (type == TRACEFMT_THREAD)
+			fprintf(outfile, "t %d\n", index);
+		else if (type == TRACEFMT_FREE)
+			fprintf(outfile, "f %d\n", index);
+		else
+			fprintf(outfile, "%c %d %d\n",
+					(type == TRACEFMT_ALLOC) ? 'a' : 'r', index, size);
+	}
+	if (rc < 0) {
+		fprintf(stderr, "%s: malformed binary trace\n", inpath);
+		exit(1);
+	}
+	munmap(buf, st.st_size);
+}
+
+int main(int argc, char **argv)
+{
+	FILE *infile, *outfile;
+	char magic[5];
+	int c, binary, fixed = 0;
+
+	while ((c = getopt(argc, argv, "Fh")) != EOF) {
+		switch (c) {
+			case 'F': /* Write the fixed-width layout */
+				fixed = 1;
+				break;
+			case 'h': /* Print this message */
+				usage();
+				exit(0);
+			default:
+				usage();
+				exit(1);
+		}
+	}
+	if (argc - optind != 2) {
+		usage();
+		exit(1);
+	}
+
+	if ((infile = fopen(argv[optind], "rb")) == NULL) {
+		perror(argv[optind]);
+		exit(1);
+	}
+	binary = fread(magic, 1, sizeof(magic), infile) == sizeof(magic) &&
+		tracefmt_is_binary(magic, sizeof(magic));
+	rewind(infile);
+	if ((outfile = fopen(argv[optind + 1], binary ? "w" : "wb")) == NULL) {
+		perror(argv[optind + 1]);
+		exit(1);
+	}
+
+	if (binary)
+		bin_to_rep(argv[optind], outfile);
+	else
+		rep_to_bin(infile, argv[optind], outfile, fixed);
+
+	fclose(infile);
+	if (fclose(outfile) != 0) {
+		perror(argv[optind + 1]);
+		exit(1);
+	}
+	exit(0);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+	fprintf(stderr, "Usage: repconv [-hF] <infile> <outfile>\n");
+	fprintf(stderr, "Converts a .rep trace to the binary trace format, or a\n");
+	fprintf(stderr, "binary trace back to a .rep trace.\n");
+	fprintf(stderr, "Options\n");
+	fprintf(stderr, "\t-F         Write the fixed-width layout, which mdriver replays in place.\n");
+	fprintf(stderr, "\t-h         Print this message.\n");
+}
@@ -0,0 +1,273 @@
+/*
+ * report.c - Machine-readable results and baseline comparison
+ *     (see report.h)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "report.h"
+
+#define UTIL_EPS 0.001  /* smallest utilization drop reported */
+
+/* Columns of the CSV form, in order; the JSON keys are the same */
+static const char *header =
+	"trace,valid,ops,secs,secs_sd,runs,util,kops,malloc,free,realloc,"
+	"sbrk,splits,coalesce,rinpl,rcopy,heap,inuse,freeb,frag";
+
+/*
+ * is_json - Does the file name end in .json?
+ */
+static int is_json(const char *path)
+{
+	size_t len = strlen(path);
+
+	return len >= 5 && !strcmp(path + len - 5, ".json");
+}
+
+/*
+ * kops - Throughput of a result in thousands of requests per second
+ */
+static double kops(report_t *r)
+{
+	return (r->secs > 0) ? r->ops / 1e3 / r->secs : 0;
+}
+
+/*
+ * put_json_str - Write s as a JSON string, escaping quotes and backslashes
+ */
+static void put_json_str(FILE *fp, const char *s)
+{
+	fputc('"', fp);
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\')
+			fputc('\\', fp);
+		fputc(*s, fp);
+	}
+	fputc('"', fp);
+}
+
+int report_write(const char *path, report_t *r, int n, report_sum_t *sum)
+{
+	FILE *fp;
+	mm_stats_t *h;
+	int i, json = is_json(path);
+
+	if ((fp = fopen(path, "w")) == NULL)
+		return -1;
+	if (json)
+		fprintf(fp, "{\"util_weight\": %g, \"libc_kops\": %g, "
+				"\"perfindex\": %.1f, \"traces\": [\n", sum->util_weight,
+				sum->libc_kops, sum->perfindex);
+	else
+		fprintf(fp, "%s\n", header);
+	for (i = 0; i < n; i++) {
+		h = &r[i].heap;
+		if (json) {
+			fprintf(fp, "{\"trace\": ");
+			put_json_str(fp, r[i].trace);
+			fprintf(fp, ", \"valid\": %d, \"ops\": %.0f, "
+					"\"secs\": %.9f, \"secs_sd\": %.9f, \"runs\": %d, "
+					"\"util\": %.6f, \"kops\": %.3f, \"malloc\": %lu, "
+					"\"free\": %lu, \"realloc\": %lu, \"sbrk\": %lu, "
+					"\"splits\": %lu, \"coalesce\": %lu, \"rinpl\": %lu, "
+					"\"rcopy\": %lu, \"heap\": %lu, \"inuse\": %lu, "
+					"\"freeb\": %lu, \"frag\": %.6f}%s\n",
+					r[i].valid, r[i].ops, r[i].secs, r[i].secs_sd,
+					r[i].runs, r[i].util, kops(&r[i]), h->malloc_calls,
+					h->free_calls, h->realloc_calls, h->sbrk_calls, h->splits,
+					h->coalesces, h->realloc_inplace,
+					h->realloc_copies + h->realloc_moves,
+					(unsigned long)h->heap_bytes, (unsigned long)h->inuse_bytes,
+					(unsigned long)h->free_bytes, h->frag,
+					(i < n - 1) ? "," : "");
+		}
+		else
+			fprintf(fp, "%s,%d,%.0f,%.9f,%.9f,%d,%.6f,%.3f,%lu,%lu,%lu,%lu,"
+					"%lu,%lu,%lu,%lu,%lu,%lu,%lu,%.6f\n",
+					r[i].trace, r[i].valid, r[i].ops, r[i].secs, r[i].secs_sd,
+					r[i].runs, r[i].util, kops(&r[i]), h->malloc_calls,
+					h->free_calls, h->realloc_calls, h->sbrk_calls, h->splits,
+					h->coalesces, h->realloc_inplace,
+					h->realloc_copies + h->realloc_moves,
+					(unsigned long)h->heap_bytes, (unsigned long)h->inuse_bytes,
+					(unsigned long)h->free_bytes, h->frag);
+	}
+	if (json)
+		fprintf(fp, "]}\n");
+	return (fclose(fp) == 0) ? 0 : -1;
+}
+
+/*
+ * json_field - Find "key": in a line of a JSON report and return what
+ *     follows it, or NULL
+ */
+static char *json_field(char *line, const char *key)
+{
+	char pat[64];
+	char *p;
+
+	sprintf(pat, "\"%s\":", key);
+	if ((p = strstr(line, pat)) == NULL)
+		return NULL;
+	for (p += strlen(pat); *p == ' '; p++)
+		;
+	return p;
+}
+
+/*
+ * get_json_str - Read the JSON string at p into buf, undoing the escapes
+ *     of put_json_str; returns -1 if it is not a string or too long
+ */
+static int get_json_str(const char *p, char *buf, size_t size)
+{
+	size_t len = 0;
+
+	if (*p++ != '"')
+		return -1;
+	for (; *p != '"'; p++) {
+		if (*p == '\\')
+			p++;
+		if (*p == '\0' || len + 1 >= size)
+			return -1;
+		buf[len++] = *p;
+	}
+	buf[len] = '\0';
+	return 0;
+}
+
+/*
+ * parse_line - Read one trace of a report; returns 0 if the line holds one
+ */
+static int parse_line(char *line, int json, report_t *r)
+{
+	char *p;
+
+	memset(r, 0, sizeof(*r));
+	if (!json)
+		return (sscanf(line, "%127[^,],%d,%lf,%lf,%lf,%d,%lf", r->trace,
+				&r->valid, &r->ops, &r->secs, &r->secs_sd, &r->runs,
+				&r->util) == 7) ? 0 : -1;
+	if ((p = json_field(line, "trace")) == NULL ||
+			get_json_str(p, r->trace, sizeof(r->trace)) < 0)
+		return -1;
+	if ((p = json_field(line, "valid")) != NULL)
+		r->valid = atoi(p);
+	if ((p = json_field(line, "ops")) != NULL)
+		r->ops = atof(p);
+	if ((p = json_field(line, "secs")) != NULL)
+		r->secs = atof(p);
+	if ((p = json_field(line, "secs_sd")) != NULL)
+		r->secs_sd = atof(p);
+	if ((p = json_field(line, "runs")) != NULL)
+		r->runs = atoi(p);
+	if ((p = json_field(line, "util")) != NULL)
+		r->util = atof(p);
+	return 0;
+}
+
+int report_read(const char *path, report_t **r)
+{
+	FILE *fp;
+	char line[4096];
+	int n = 0, cap = 0, json = is_json(path);
+	report_t *new;
+
+	if ((fp = fopen(path, "r")) == NULL)
+		return -1;
+	*r = NULL;
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		if (!json && !strncmp(line, "trace,", 6))
+			continue;
+		if (n == cap) {
+			cap = cap ? 2 * cap : 16;
+			if ((new = realloc(*r, cap * sizeof(report_t))) == NULL)
+				break;
+			*r = new;
+		}
+		if (parse_line(line, json, &(*r)[n]) == 0)
+			n++;
+	}
+	fclose(fp);
+	if (n == 0) {
+		free(*r);
+		*r = NULL;
+		return -1;
+	}
+	return n;
+}
+
+/*
+ * t_crit - One-sided 95% critical value of Student's t with df degrees
+ *     of freedom
+ */
+static double t_crit(double df)
+{
+	static const double t[] = {6.314, 2.920, 2.353, 2.132, 2.015, 1.943,
+		1.895, 1.860, 1.833, 1.812, 1.796, 1.782, 1.771, 1.761, 1.753,
+		1.746, 1.740, 1.734, 1.729, 1.725};
+	int i = (int)df;
+
+	if (i < 1)
+		i = 1;
+	if (i <= 20)
+		return t[i - 1];
+	return (i <= 30) ? 1.697 : 1.645;
+}
+
+/*
+ * slower - Is cur significantly slower than base? Sets *t to the Welch
+ *     t statistic, or to NAN if there are too few runs to compute it
+ */
+static int slower(report_t *base, report_t *cur, double threshold, double *t)
+{
+	double vb, vc, se, df = 0;
+	int dropped = cur->secs > base->secs * (1 + threshold);
+
+	*t = NAN;
+	if (base->runs < 2 || cur->runs < 2)
+		return dropped;
+	vb = base->secs_sd * base->secs_sd / base->runs;
+	vc = cur->secs_sd * cur->secs_sd / cur->runs;
+	if ((se = sqrt(vb + vc)) == 0)
+		return dropped;
+	*t = (cur->secs - base->secs) / se;
+	df = (vb + vc) * (vb + vc) / (vb * vb / (base->runs - 1) +
+			vc * vc / (cur->runs - 1));
+	return dropped && *t > t_crit(df);
+}
+
+int report_compare(report_t *base, int nbase, report_t *cur, int n,
+		double threshold)
+{
+	int i, j, regressions = 0, slow, worse;
+	double t;
+
+	printf("Compared with the baseline (regression threshold %.1f%%):\n",
+			threshold * 100);
+	printf("%5s%9s%9s%8s%10s%10s%8s%7s  %s\n", "trace", "util", "base",
+			"diff", "Kops", "base", "diff", "t", "");
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < nbase && strcmp(base[j].trace, cur[i].trace); j++)
+			;
+		if (j == nbase || !base[j].valid || !cur[i].valid) {
+			printf("%2d%12s\n", i, (j == nbase) ? "not in baseline" :
+					"invalid");
+			continue;
+		}
+		worse = cur[i].util < base[j].util - UTIL_EPS;
+		slow = slower(&base[j], &cur[i], threshold, &t);
+		printf("%2d%11.1f%%%8.1f%%%+8.1f%10.0f%10.0f%+7.1f%%", i,
+				cur[i].util * 100, base[j].util * 100,
+				(cur[i].util - base[j].util) * 100, kops(&cur[i]),
+				kops(&base[j]), (kops(&cur[i]) / kops(&base[j]) - 1) * 100);
+		if (!isnan(t))
+			printf("%7.2f", t);
+		else
+			printf("%7s", "-");
+		printf("  %s%s\n", worse ? "UTIL " : "", slow ? "SLOWER" : "");
+		regressions += worse + slow;
+	}
+	return regressions;
+}
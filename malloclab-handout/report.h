@@ -0,0 +1,55 @@
+/*
+ * report.h - Machine-readable results of mdriver, and comparison of
+ *     one run against a stored baseline
+ *
+ * A report is written as CSV, or as JSON when the file name ends in
+ * .json, with one row (or one object, on its own line) per trace. Either
+ * form can be read back as a baseline.
+ */
+#ifndef __REPORT_H_
+#define __REPORT_H_
+
+#include "mm.h"
+
+#define REPORT_NAMELEN 128
+
+/* The results of the mm package on one trace */
+typedef struct {
+	char trace[REPORT_NAMELEN]; /* trace file name */
+	int valid;                  /* the other fields are only set if valid */
+	double ops;                 /* requests in the trace */
+	double secs;                /* mean time to replay the trace */
+	double secs_sd;             /* standard deviation of the replay times */
+	int runs;                   /* replay times measured */
+	double util;                /* space utilization */
+	mm_stats_t heap;            /* allocator statistics (not read back) */
+} report_t;
+
+/* Summary of the whole run */
+typedef struct {
+	double util_weight;         /* UTIL_WEIGHT of the perf index */
+	double libc_kops;           /* AVG_LIBC_THRUPUT / 1e3 */
+	double perfindex;           /* -1 if there were errors */
+} report_sum_t;
+
+/* Write n results to path; returns -1 if it cannot be written */
+int report_write(const char *path, report_t *r, int n, report_sum_t *sum);
+
+/*
+ * Read the results stored in path into a new array in *r; returns their
+ * number, or -1 if the file cannot be read or is not a report
+ */
+int report_read(const char *path, report_t **r);
+
+/*
+ * Print how the traces of cur compare with the same traces in base and
+ * return the number of regressions. Throughput has regressed when it
+ * dropped by more than threshold (a fraction) and, if both sides timed
+ * two or more runs, a one-sided Welch t-test finds the drop significant
+ * at the 95% level. Utilization is deterministic, so any drop of more
+ * than 0.1 points counts.
+ */
+int report_compare(report_t *base, int nbase, report_t *cur, int n,
+		double threshold);
+
+#endif /* __REPORT_H_ */
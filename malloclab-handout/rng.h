@@ -0,0 +1,22 @@
+/*
+ * rng.h - Small fast pseudo-random numbers for the benchmarks and tools
+ *
+ * xorshift64*: the state must start non-zero and then never becomes zero.
+ * Good enough for picking sizes and blocks, not for anything else.
+ */
+#ifndef __RNG_H_
+#define __RNG_H_
+
+/* Advance *state and return the next 64 random bits */
+static inline unsigned long long rng_next(unsigned long long *state)
+{
+	unsigned long long x = *state;
+
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+	return x * 2685821657736338717ULL;
+}
+
+#endif /* __RNG_H_ */
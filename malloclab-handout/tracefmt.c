@@ -0,0 +1,307 @@
+/*
+ * tracefmt.c - Encoders and decoders for the binary trace formats
+ *     described in tracefmt.h
+ */
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+
+#include "tracefmt.h"
+
+/*
+ * put_varint - Write val 7 bits at a time, low bits first
+ */
+static void put_varint(FILE *fp, unsigned long val)
+{
+	while (val >= 0x80) {
+		fputc((int)(val & 0x7f) | 0x80, fp);
+		val >>= 7;
+	}
+	fputc((int)val, fp);
+}
+
+/*
+ * get_varint - Decode a varint at c->p; returns -1 if it runs past
+ *     the end of the buffer or does not fit in an unsigned long
+ */
+static int get_varint(tracefmt_cursor_t *c, unsigned long *val)
+{
+	unsigned long v = 0;
+	int shift = 0;
+
+	while (c->p < c->end) {
+		if (shift >= 8 * (int)sizeof(v))
+			return -1;
+		v |= (unsigned long)(*c->p & 0x7f) << shift;
+		if (!(*c->p++ & 0x80)) {
+			*val = v;
+			return 0;
+		}
+		shift += 7;
+	}
+	return -1;
+}
+
+/*
+ * tracefmt_is_binary - Does the buffer start with the binary magic?
+ */
+int tracefmt_is_binary(const void *buf, size_t len)
+{
+	return len >= 5 && !memcmp(buf, TRACEFMT_MAGIC, 4);
+}
+
+/*
+ * tracefmt_open - Check the magic and version, decode the header and
+ *     leave c at the first op
+ */
+int tracefmt_open(tracefmt_cursor_t *c, const void *buf, size_t len,
+		tracefmt_hdr_t *hdr)
+{
+	unsigned long v[4];
+	int i;
+
+	if (!tracefmt_is_binary(buf, len) ||
+			((const unsigned char *)buf)[4] != TRACEFMT_VERSION)
+		return -1;
+	c->p = (const unsigned char *)buf + 5;
+	c->end = (const unsigned char *)buf + len;
+	c->prev_id = 0;
+	for (i = 0; i < 4; i++)
+		if (get_varint(c, &v[i]) < 0)
+			return -1;
+	hdr->sugg_heapsize = (int)v[0];
+	hdr->num_ids = (int)v[1];
+	hdr->num_ops = (int)v[2];
+	hdr->weight = (int)v[3];
+	return 0;
+}
+
+/*
+ * tracefmt_open_fixed - Check the fixed-width header and the length of
+ *     the trace and return its records
+ */
+const tracefmt_rec_t *tracefmt_open_fixed(const void *buf, size_t len,
+		tracefmt_hdr_t *hdr, int *num_threads)
+{
+	const unsigned char *b = buf;
+	int v[6];
+
+	if (len < TRACEFMT_FIXED_HDR || !tracefmt_is_binary(buf, len) ||
+			b[4] != TRACEFMT_FIXED)
+		return NULL;
+	memcpy(v, b + 8, sizeof(v));
+	if (v[2] < 0 || v[4] < 1 || len - TRACEFMT_FIXED_HDR !=
+			(size_t)v[2] * sizeof(tracefmt_rec_t))
+		return NULL;
+	hdr->sugg_heapsize = v[0];
+	hdr->num_ids = v[1];
+	hdr->num_ops = v[2];
+	hdr->weight = v[3];
+	*num_threads = v[4];
+	return (const tracefmt_rec_t *)(b + TRACEFMT_FIXED_HDR);
+}
+
+/*
+ * tracefmt_next - Decode the op at c->p
+ */
+int tracefmt_next(tracefmt_cursor_t *c, int *type, int *id, int *size)
+{
+	unsigned long tag, delta, sz = 0;
+
+	if (c->p == c->end)
+		return 0;
+	if (get_varint(c, &tag) < 0)
+		return -1;
+	*type = (int)(tag & 0x3);
+	if (*type == TRACEFMT_THREAD) {
+		if ((tag >> 2) > INT_MAX)
+			return -1;
+		*id = (int)(tag >> 2);
+		*size = 0;
+		return 1;
+	}
+	delta = tag >> 2;
+	/* undo the zigzag encoding */
+	c->prev_id += (delta & 1) ? -(long)(delta >> 1) - 1 : (long)(delta >> 1);
+	*id = c->prev_id;
+	if (*type == TRACEFMT_ALLOC || *type == TRACEFMT_REALLOC) {
+		if (get_varint(c, &sz) < 0 || sz > INT_MAX)
+			return -1;
+	}
+	*size = (int)sz;
+	return 1;
+}
+
+/*
+ * read_varint - Read a varint from fp; returns 0 at the end of the file
+ *     before the first byte and -1 if the varint is truncated or too long
+ */
+static int read_varint(FILE *fp, unsigned long *val)
+{
+	unsigned long v = 0;
+	int shift = 0, c;
+
+	while ((c = getc(fp)) != EOF) {
+		if (shift >= 8 * (int)sizeof(v))
+			return -1;
+		v |= (unsigned long)(c & 0x7f) << shift;
+		if (!(c & 0x80)) {
+			*val = v;
+			return 1;
+		}
+		shift += 7;
+	}
+	return (shift == 0) ? 0 : -1;
+}
+
+/*
+ * tracefmt_read_hdr - Read the header fields that follow the version
+ */
+int tracefmt_read_hdr(FILE *fp, tracefmt_hdr_t *hdr)
+{
+	unsigned long v[4];
+	int i;
+
+	for (i = 0; i < 4; i++)
+		if (read_varint(fp, &v[i]) <= 0)
+			return -1;
+	hdr->sugg_heapsize = (int)v[0];
+	hdr->num_ids = (int)v[1];
+	hdr->num_ops = (int)v[2];
+	hdr->weight = (int)v[3];
+	return 0;
+}
+
+/*
+ * tracefmt_read_op - Read the next op from fp
+ */
+int tracefmt_read_op(FILE *fp, int *prev_id, int *type, int *id, int *size)
+{
+	unsigned long tag, delta, sz = 0;
+	int rc;
+
+	if ((rc = read_varint(fp, &tag)) <= 0)
+		return rc;
+	*type = (int)(tag & 0x3);
+	if (*type == TRACEFMT_THREAD) {
+		if ((tag >> 2) > INT_MAX)
+			return -1;
+		*id = (int)(tag >> 2);
+		*size = 0;
+		return 1;
+	}
+	delta = tag >> 2;
+	*prev_id += (delta & 1) ? -(long)(delta >> 1) - 1 : (long)(delta >> 1);
+	*id = *prev_id;
+	if (*type == TRACEFMT_ALLOC || *type == TRACEFMT_REALLOC) {
+		if (read_varint(fp, &sz) <= 0 || sz > INT_MAX)
+			return -1;
+	}
+	*size = (int)sz;
+	return 1;
+}
+
+/*
+ * tracefmt_read_fixed_hdr - Read the fixed-width header fields that
+ *     follow the version
+ */
+int tracefmt_read_fixed_hdr(FILE *fp, tracefmt_hdr_t *hdr, int *num_threads)
+{
+	char pad[3];
+	int v[6];
+
+	if (fread(pad, 1, sizeof(pad), fp) != sizeof(pad) ||
+			fread(v, sizeof(int), 6, fp) != 6 || v[2] < 0 || v[4] < 1)
+		return -1;
+	hdr->sugg_heapsize = v[0];
+	hdr->num_ids = v[1];
+	hdr->num_ops = v[2];
+	hdr->weight = v[3];
+	*num_threads = v[4];
+	return 0;
+}
+
+/*
+ * tracefmt_read_rec - Read the next fixed-width record; returns 0 at the
+ *     end and -1 if the file ends inside a record
+ */
+int tracefmt_read_rec(FILE *fp, tracefmt_rec_t *rec)
+{
+	size_t n = fread(rec, 1, sizeof(*rec), fp);
+
+	if (n == sizeof(*rec))
+		return 1;
+	return (n == 0 && feof(fp)) ? 0 : -1;
+}
+
+/*
+ * tracefmt_put_hdr - Write the magic, version and header fields
+ */
+void tracefmt_put_hdr(FILE *fp, const tracefmt_hdr_t *hdr)
+{
+	fwrite(TRACEFMT_MAGIC, 1, 4, fp);
+	fputc(TRACEFMT_VERSION, fp);
+	put_varint(fp, (unsigned long)hdr->sugg_heapsize);
+	put_varint(fp, (unsigned long)hdr->num_ids);
+	put_varint(fp, (unsigned long)hdr->num_ops);
+	put_varint(fp, (unsigned long)hdr->weight);
+}
+
+/*
+ * tracefmt_put_op - Write one op, delta-encoding its id against *prev_id
+ */
+void tracefmt_put_op(FILE *fp, int *prev_id, int type, int id, int size)
+{
+	long delta = (long)id - *prev_id;
+	unsigned long zz = (delta < 0) ? ((unsigned long)(-delta - 1) << 1) | 1
+		: (unsigned long)delta << 1;
+
+	put_varint(fp, (zz << 2) | (unsigned long)type);
+	if (type != TRACEFMT_FREE)
+		put_varint(fp, (unsigned long)size);
+	*prev_id = id;
+}
+
+/*
+ * tracefmt_put_thread - Write a switch to thread tid
+ */
+void tracefmt_put_thread(FILE *fp, int tid)
+{
+	put_varint(fp, ((unsigned long)tid << 2) | TRACEFMT_THREAD);
+}
+
+/*
+ * tracefmt_put_fixed_hdr - Write the magic, version and header of a
+ *     fixed-width trace
+ */
+void tracefmt_put_fixed_hdr(FILE *fp, const tracefmt_hdr_t *hdr,
+		int num_threads)
+{
+	static const char pad[3];
+	int v[6];
+
+	v[0] = hdr->sugg_heapsize;
+	v[1] = hdr->num_ids;
+	v[2] = hdr->num_ops;
+	v[3] = hdr->weight;
+	v[4] = num_threads;
+	v[5] = 0;
+	fwrite(TRACEFMT_MAGIC, 1, 4, fp);
+	fputc(TRACEFMT_FIXED, fp);
+	fwrite(pad, 1, sizeof(pad), fp);
+	fwrite(v, sizeof(int), 6, fp);
+}
+
+/*
+ * tracefmt_put_rec - Write one fixed-width record
+ */
+void tracefmt_put_rec(FILE *fp, int type, int id, int size, int tid)
+{
+	tracefmt_rec_t rec;
+
+	rec.type = type;
+	rec.id = id;
+	rec.size = size;
+	rec.tid = tid;
+	fwrite(&rec, sizeof(rec), 1, fp);
+}
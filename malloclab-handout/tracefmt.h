@@ -0,0 +1,109 @@
+/*
+ * tracefmt.h - Compact binary trace format
+ *
+ * A binary trace holds the same information as a .rep file. It starts
+ * with the magic "MMTR" and a version byte, followed by the four .rep
+ * header fields (suggested heap size, number of ids, number of ops and
+ * weight) as varints. Each op is then a varint tag holding the op type
+ * in its low two bits and the zigzag-encoded difference between its id
+ * and the id of the previous op above them; alloc and realloc ops are
+ * followed by the size as a varint. Varints store 7 bits per byte, low
+ * bits first, with the high bit set on every byte but the last.
+ *
+ * Multi-threaded traces also hold thread switches: a tag with type
+ * TRACEFMT_THREAD carries the id of the thread that issues the ops after
+ * it instead of an id delta. Ops before the first switch belong to
+ * thread 0. Switches are not counted in the number of ops.
+ *
+ * The fixed-width layout, version TRACEFMT_FIXED, trades size for load
+ * time. The version byte is followed by three zero bytes, the four
+ * header fields, the number of threads and a zero word as ints, and
+ * then one tracefmt_rec_t per op in host byte order, with the thread
+ * switches folded into each record's tid. The records start
+ * TRACEFMT_FIXED_HDR bytes in, so a mapped trace can be replayed where
+ * it lies without decoding.
+ */
+#ifndef __TRACEFMT_H_
+#define __TRACEFMT_H_
+
+#include <stdio.h>
+
+#define TRACEFMT_MAGIC   "MMTR"
+#define TRACEFMT_VERSION 1
+#define TRACEFMT_FIXED   2   /* version byte of the fixed-width layout */
+#define TRACEFMT_FIXED_HDR 32 /* bytes before the first fixed-width record */
+
+/* Op types, numbered like the request types in mdriver.c */
+#define TRACEFMT_ALLOC   0
+#define TRACEFMT_FREE    1
+#define TRACEFMT_REALLOC 2
+#define TRACEFMT_THREAD  3   /* thread switch; the id is the thread id */
+
+/* The .rep header fields */
+typedef struct {
+	int sugg_heapsize;
+	int num_ids;
+	int num_ops;
+	int weight;
+} tracefmt_hdr_t;
+
+/* One op of a fixed-width trace */
+typedef struct {
+	int type;   /* TRACEFMT_ALLOC, _FREE or _REALLOC */
+	int id;
+	int size;
+	int tid;    /* thread that issues the op */
+} tracefmt_rec_t;
+
+/* Position in a binary trace held in memory */
+typedef struct {
+	const unsigned char *p;    /* next byte to decode */
+	const unsigned char *end;  /* one past the last byte */
+	int prev_id;               /* id of the previous op */
+} tracefmt_cursor_t;
+
+/* Returns 1 if the first len bytes of buf start a binary trace */
+int tracefmt_is_binary(const void *buf, size_t len);
+
+/* Decode the header and set up c to read the ops; -1 if malformed */
+int tracefmt_open(tracefmt_cursor_t *c, const void *buf, size_t len,
+		tracefmt_hdr_t *hdr);
+
+/*
+ * Check the header of a fixed-width trace of len bytes in memory and
+ * return its first record, or NULL if the header is malformed or len
+ * does not hold exactly num_ops records. The records are not checked.
+ */
+const tracefmt_rec_t *tracefmt_open_fixed(const void *buf, size_t len,
+		tracefmt_hdr_t *hdr, int *num_threads);
+
+/*
+ * Decode the next op; returns 0 at the end and -1 if malformed, which
+ * includes a size or thread id above INT_MAX. For a thread switch,
+ * *type is TRACEFMT_THREAD and *id is the thread id.
+ */
+int tracefmt_next(tracefmt_cursor_t *c, int *type, int *id, int *size);
+
+/* 
+ * Stream decoders reading from fp, which must be past the magic and
+ * version byte. They return -1 on a malformed trace; tracefmt_read_op
+ * returns 0 at the end and updates prev_id.
+ */
+int tracefmt_read_hdr(FILE *fp, tracefmt_hdr_t *hdr);
+int tracefmt_read_op(FILE *fp, int *prev_id, int *type, int *id, int *size);
+
+/* The same for the fixed-width layout */
+int tracefmt_read_fixed_hdr(FILE *fp, tracefmt_hdr_t *hdr, int *num_threads);
+int tracefmt_read_rec(FILE *fp, tracefmt_rec_t *rec);
+
+/* Encoders writing to fp; prev_id is updated by tracefmt_put_op */
+void tracefmt_put_hdr(FILE *fp, const tracefmt_hdr_t *hdr);
+void tracefmt_put_op(FILE *fp, int *prev_id, int type, int id, int size);
+void tracefmt_put_thread(FILE *fp, int tid);
+
+/* Encoders for the fixed-width layout */
+void tracefmt_put_fixed_hdr(FILE *fp, const tracefmt_hdr_t *hdr,
+		int num_threads);
+void tracefmt_put_rec(FILE *fp, int type, int id, int size, int tid);
+
+#endif /* __TRACEFMT_H_ */
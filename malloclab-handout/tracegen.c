@@ -0,0 +1,361 @@
+/*
+ * tracegen.c - Generates synthetic .rep traces from size and lifetime
+ *     distributions
+ *
+ * Time advances by one tick per allocation. Every block is given a
+ * lifetime when it is allocated and is freed once its time is up; when
+ * the live bytes exceed the peak target, the blocks closest to their
+ * end are freed early. Between allocations, a live block picked at
+ * random may be grown by realloc. Whatever is live at the end is freed,
+ * so every trace is balanced. The output depends only on the options
+ * and the seed.
+ *
+ * Distributions are given as name:arg:arg...
+ *
+ *	sizes:     fixed:S  uniform:LO:HI  powerlaw:ALPHA:LO:HI
+ *	           bimodal:S1:S2:P1  classes:S1,S2,...
+ *	lifetimes: fixed:T  uniform:LO:HI  exp:MEAN  forever
+ *
+ * Lifetimes are counted in allocations. For example
+ *
+ *	unix> tracegen -n 20000 -s powerlaw:1.5:8:65536 -l exp:500 -m 1048576 > pl.rep
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+#include "rng.h"
+
+#define MAXCLASSES 64
+#define MAXGROW    (1 << 20)  /* reallocs do not grow a block past this */
+
+/* A size or lifetime distribution */
+typedef struct {
+	enum {D_FIXED, D_UNIFORM, D_POWERLAW, D_BIMODAL, D_CLASSES, D_EXP,
+		D_FOREVER} kind;
+	double a, b, c;                 /* parameters, as in the table above */
+	int nclasses;
+	double classes[MAXCLASSES];
+} dist_t;
+
+/* A live block; the heap of live blocks is ordered by death time */
+typedef struct {
+	long death;
+	int id;
+	int size;
+} block_t;
+
+/* One request of the trace */
+typedef struct {
+	char type;
+	int id;
+	int size;
+} op_t;
+
+static unsigned long long rng_state;
+
+static block_t *heap;            /* min-heap of live blocks by death */
+static int nlive, heapcap;
+static op_t *ops;
+static int nops, opcap;
+
+static void usage(void);
+
+/*
+ * rng_unit - uniform double in (0, 1)
+ */
+static double rng_unit(void)
+{
+	return ((rng_next(&rng_state) >> 11) + 0.5) / 9007199254740992.0;
+}
+
+/*
+ * parse_dist - Parse name:arg:... into d; returns -1 if it is not valid
+ */
+static int parse_dist(const char *spec, dist_t *d)
+{
+	char name[32], *p;
+	const char *args = strchr(spec, ':');
+	size_t len = args ? (size_t)(args - spec) : strlen(spec);
+	int n = 0;
+
+	if (len >= sizeof(name))
+		return -1;
+	memcpy(name, spec, len);
+	name[len] = '\0';
+	memset(d, 0, sizeof(*d));
+	if (args != NULL)
+		n = sscanf(args, ":%lf:%lf:%lf", &d->a, &d->b, &d->c);
+
+	if (!strcmp(name, "fixed")) {
+		d->kind = D_FIXED;
+		return (n == 1 && d->a >= 0) ? 0 : -1;
+	}
+	if (!strcmp(name, "uniform")) {
+		d->kind = D_UNIFORM;
+		return (n == 2 && d->a >= 0 && d->a <= d->b) ? 0 : -1;
+	}
+	if (!strcmp(name, "powerlaw")) {
+		d->kind = D_POWERLAW;
+		return (n == 3 && d->a > 0 && d->b > 0 && d->b < d->c) ? 0 : -1;
+	}
+	if (!strcmp(name, "bimodal")) {
+		d->kind = D_BIMODAL;
+		return (n == 3 && d->c >= 0 && d->c <= 1) ? 0 : -1;
+	}
+	if (!strcmp(name, "exp")) {
+		d->kind = D_EXP;
+		return (n == 1 && d->a > 0) ? 0 : -1;
+	}
+	if (!strcmp(name, "forever")) {
+		d->kind = D_FOREVER;
+		return (args == NULL) ? 0 : -1;
+	}
+	if (!strcmp(name, "classes") && args != NULL) {
+		d->kind = D_CLASSES;
+		for (p = (char *)args + 1; *p != '\0'; p++) {
+			if (d->nclasses == MAXCLASSES)
+				return -1;
+			d->classes[d->nclasses++] = strtod(p, &p);
+			if (*p != ',')
+				break;
+		}
+		return (*p == '\0' && d->nclasses > 0) ? 0 : -1;
+	}
+	return -1;
+}
+
+/*
+ * draw - Draw a value from d
+ */
+static double draw(dist_t *d)
+{
+	double u = rng_unit(), la, ha;
+
+	switch (d->kind) {
+		case D_FIXED:
+			return d->a;
+		case D_UNIFORM:
+			return d->a + floor(u * (d->b - d->a + 1));
+		case D_POWERLAW:
+			/* inverse CDF of a Pareto distribution bounded to [b, c] */
+			la = pow(d->b, d->a);
+			ha = pow(d->c, d->a);
+			return floor(pow(-(u * ha - u * la - ha) / (ha * la), -1 / d->a));
+		case D_BIMODAL:
+			return (u < d->c) ? d->a : d->b;
+		case D_CLASSES:
+			return d->classes[(int)(u * d->nclasses)];
+		case D_EXP:
+			return floor(-d->a * log(u));
+		case D_FOREVER:
+		default:
+			return -1;
+	}
+}
+
+/*
+ * emit - Append a request to the trace
+ */
+static void emit(char type, int id, int size)
+{
+	if (nops == opcap) {
+		opcap = opcap ? 2 * opcap : 4096;
+		if ((ops = realloc(ops, opcap * sizeof(op_t))) == NULL) {
+			perror("realloc");
+			exit(1);
+		}
+	}
+	ops[nops].type = type;
+	ops[nops].id = id;
+	ops[nops].size = size;
+	nops++;
+}
+
+/*
+ * heap_push, heap_pop - The live blocks, soonest death first
+ */
+static void heap_push(block_t b)
+{
+	int i, parent;
+
+	if (nlive == heapcap) {
+		heapcap = heapcap ? 2 * heapcap : 1024;
+		if ((heap = realloc(heap, heapcap * sizeof(block_t))) == NULL) {
+			perror("realloc");
+			exit(1);
+		}
+	}
+	for (i = nlive++; i > 0 && heap[parent = (i - 1) / 2].death > b.death;
+			i = parent)
+		heap[i] = heap[parent];
+	heap[i] = b;
+}
+
+static block_t heap_pop(void)
+{
+	block_t top = heap[0], last = heap[--nlive];
+	int i = 0, child;
+
+	while ((child = 2 * i + 1) < nlive) {
+		if (child + 1 < nlive && heap[child + 1].death < heap[child].death)
+			child++;
+		if (heap[child].death >= last.death)
+			break;
+		heap[i] = heap[child];
+		i = child;
+	}
+	heap[i] = last;
+	return top;
+}
+
+int main(int argc, char **argv)
+{
+	dist_t sizes, lifetimes;
+	long ticks = 10000, t, live = 0, peak = 0, maxlive = 0;
+	double realloc_prob = 0, growth = 1.5, life;
+	unsigned long long seed = 1;
+	int c, i, size, nids = 0;
+	char *outname = NULL;
+	FILE *out = stdout;
+	block_t b, *victim;
+
+	parse_dist("uniform:1:512", &sizes);
+	parse_dist("exp:100", &lifetimes);
+	while ((c = getopt(argc, argv, "n:s:l:r:g:m:S:o:h")) != EOF) {
+		switch (c) {
+			case 'n': /* Number of allocations */
+				ticks = atol(optarg);
+				break;
+			case 's': /* Size distribution */
+				if (parse_dist(optarg, &sizes) < 0 || sizes.kind == D_EXP ||
+						sizes.kind == D_FOREVER) {
+					fprintf(stderr, "tracegen: bad size distribution %s\n", optarg);
+					exit(1);
+				}
+				break;
+			case 'l': /* Lifetime distribution */
+				if (parse_dist(optarg, &lifetimes) < 0 ||
+						lifetimes.kind == D_CLASSES) {
+					fprintf(stderr, "tracegen: bad lifetime distribution %s\n",
+							optarg);
+					exit(1);
+				}
+				break;
+			case 'r': /* Probability of a realloc before each allocation */
+				realloc_prob = atof(optarg);
+				break;
+			case 'g': /* Growth factor of reallocs */
+				growth = atof(optarg);
+				break;
+			case 'm': /* Peak live bytes */
+				maxlive = atol(optarg);
+				break;
+			case 'S': /* Seed */
+				seed = strtoull(optarg, NULL, 0);
+				break;
+			case 'o': /* Output file */
+				outname = optarg;
+				break;
+			case 'h': /* Print this message */
+				usage();
+				exit(0);
+			default:
+				usage();
+				exit(1);
+		}
+	}
+	if (optind != argc || ticks <= 0 || growth <= 0) {
+		usage();
+		exit(1);
+	}
+	rng_state = seed ? seed : 1;
+
+	for (t = 0; t < ticks; t++) {
+		/* Free the blocks whose time is up */
+		while (nlive > 0 && heap[0].death <= t) {
+			b = heap_pop();
+			emit('f', b.id, 0);
+			live -= b.size;
+		}
+
+		/* Grow a live block */
+		if (nlive > 0 && rng_unit() < realloc_prob) {
+			victim = &heap[(int)(rng_unit() * nlive)];
+			size = (int)(victim->size * growth);
+			if (size < 1)
+				size = 1;
+			if (size > MAXGROW && size > victim->size)
+				size = (victim->size > MAXGROW) ? victim->size : MAXGROW;
+			emit('r', victim->id, size);
+			live += size - victim->size;
+			victim->size = size;
+		}
+
+		/* Allocate a new block */
+		size = (int)draw(&sizes);
+		if (size < 1)
+			size = 1;
+		life = draw(&lifetimes);
+		b.death = (life < 0) ? ticks : t + 1 + (long)life;
+		b.id = nids++;
+		b.size = size;
+		emit('a', b.id, size);
+		heap_push(b);
+		live += size;
+
+		/* Respect the peak target, freeing the blocks that die soonest */
+		while (maxlive > 0 && live > maxlive && nlive > 1) {
+			b = heap_pop();
+			emit('f', b.id, 0);
+			live -= b.size;
+		}
+		if (live > peak)
+			peak = live;
+	}
+	while (nlive > 0) {
+		b = heap_pop();
+		emit('f', b.id, 0);
+	}
+
+	if (outname != NULL && (out = fopen(outname, "w")) == NULL) {
+		perror(outname);
+		exit(1);
+	}
+	fprintf(out, "%ld\n%d\n%d\n%d\n", peak, nids, nops, 1);
+	for (i = 0; i < nops; i++) {
+		if (ops[i].type == 'f')
+			fprintf(out, "f %d\n", ops[i].id);
+		else
+			fprintf(out, "%c %d %d\n", ops[i].type, ops[i].id, ops[i].size);
+	}
+	if (fclose(out) != 0) {
+		perror(outname ? outname : "stdout");
+		exit(1);
+	}
+	exit(0);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+	fprintf(stderr, "Usage: tracegen [-h] [-n <allocs>] [-s <sizes>] [-l <lifetimes>]\n");
+	fprintf(stderr, "                [-r <prob>] [-g <growth>] [-m <bytes>] [-S <seed>] [-o <file>]\n");
+	fprintf(stderr, "Options\n");
+	fprintf(stderr, "\t-g <growth>    Size factor of each realloc (default 1.5).\n");
+	fprintf(stderr, "\t-h             Print this message.\n");
+	fprintf(stderr, "\t-l <lifetimes> Lifetime distribution in allocations (default exp:100).\n");
+	fprintf(stderr, "\t-m <bytes>     Keep the live bytes at or below <bytes>.\n");
+	fprintf(stderr, "\t-n <allocs>    Number of allocations (default 10000).\n");
+	fprintf(stderr, "\t-o <file>      Write the trace to <file> instead of stdout.\n");
+	fprintf(stderr, "\t-r <prob>      Chance of a realloc before each allocation.\n");
+	fprintf(stderr, "\t-s <sizes>     Size distribution (default uniform:1:512).\n");
+	fprintf(stderr, "\t-S <seed>      Seed of the random number generator (default 1).\n");
+	fprintf(stderr, "Sizes:     fixed:S uniform:LO:HI powerlaw:ALPHA:LO:HI bimodal:S1:S2:P1\n");
+	fprintf(stderr, "           classes:S1,S2,...\n");
+	fprintf(stderr, "Lifetimes: fixed:T uniform:LO:HI exp:MEAN forever\n");
+}
@@ -0,0 +1,234 @@
+/*
+ * tracestream.c - Reads a trace in bounded chunks on a background thread
+ *
+ * The reader fills a ring of NBUFS chunks in order and the consumer
+ * drains them in the same order. A chunk handed out by ts_next belongs
+ * to the consumer until its next call, so the reader can stay up to
+ * NBUFS-1 chunks ahead.
+ *
+ * Thread switches in multi-threaded traces are skipped, so their ops are
+ * replayed in the order in which they were recorded.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "tracestream.h"
+
+#define NBUFS   3    /* chunks in the ring */
+#define MAXLINE 1024
+
+struct tracestream {
+	FILE *fp;
+	int binary;                 /* binary format (see tracefmt.h)? */
+	int fixed;                  /* in the fixed-width layout? */
+	int prev_id;                /* last id decoded from a binary trace */
+	pthread_t reader;
+	pthread_mutex_t lock;
+	pthread_cond_t filled;      /* signalled when a chunk is full */
+	pthread_cond_t emptied;     /* signalled when a chunk is released */
+	tsop_t *bufs[NBUFS];
+	int counts[NBUFS];          /* ops in each chunk */
+	int full[NBUFS];            /* chunk holds ops not yet consumed */
+	int head;                   /* next chunk the consumer will take */
+	int held;                   /* chunk held by the consumer, or -1 */
+	int done;                   /* reader reached the end (1) or an error (-1) */
+	int stop;                   /* ts_close asked the reader to stop */
+	double stall;               /* seconds the consumer waited */
+};
+
+/*
+ * read_op - Parse the next op of the trace; returns 1 if there was one,
+ *     0 at the end and -1 if the trace is malformed
+ */
+static int read_op(tracestream_t *ts, tsop_t *op)
+{
+	char type[MAXLINE];
+	tracefmt_rec_t rec;
+	int rc;
+
+	if (ts->fixed) {
+		if ((rc = tracefmt_read_rec(ts->fp, &rec)) > 0) {
+			op->type = rec.type;
+			op->id = rec.id;
+			op->size = rec.size;
+		}
+		return rc;
+	}
+	if (ts->binary) {
+		while ((rc = tracefmt_read_op(ts->fp, &ts->prev_id, &op->type, &op->id,
+						&op->size)) > 0 && op->type == TRACEFMT_THREAD)
+			;
+		return rc;
+	}
+
+	do {
+		if (fscanf(ts->fp, "%s", type) != 1)
+			return 0;
+	} while (type[0] == 't' && fscanf(ts->fp, "%d", &op->id) == 1);
+	op->size = 0;
+	switch (type[0]) {
+		case 'a':
+		case 'r':
+			op->type = (type[0] == 'a') ? TRACEFMT_ALLOC : TRACEFMT_REALLOC;
+			return (fscanf(ts->fp, "%d %d", &op->id, &op->size) == 2) ? 1 : -1;
+		case 'f':
+			op->type = TRACEFMT_FREE;
+			return (fscanf(ts->fp, "%d", &op->id) == 1) ? 1 : -1;
+		default:
+			return -1;
+	}
+}
+
+/*
+ * reader - Body of the reader thread: fill chunks until the end
+ */
+static void *reader(void *arg)
+{
+	tracestream_t *ts = arg;
+	int b = 0, n, rc = 1, stop;
+
+	while (rc > 0) {
+		pthread_mutex_lock(&ts->lock);
+		while ((ts->full[b] || ts->held == b) && !ts->stop)
+			pthread_cond_wait(&ts->emptied, &ts->lock);
+		stop = ts->stop;
+		pthread_mutex_unlock(&ts->lock);
+		if (stop)
+			break;
+
+		/* Parse outside the lock so the consumer can keep going */
+		for (n = 0; n < TS_CHUNKOPS; n++)
+			if ((rc = read_op(ts, &ts->bufs[b][n])) <= 0)
+				break;
+
+		pthread_mutex_lock(&ts->lock);
+		ts->counts[b] = n;
+		ts->full[b] = (n > 0);
+		if (rc <= 0)
+			ts->done = (rc < 0) ? -1 : 1;
+		pthread_cond_signal(&ts->filled);
+		pthread_mutex_unlock(&ts->lock);
+		b = (b + 1) % NBUFS;
+	}
+	return NULL;
+}
+
+/*
+ * ts_open - Read the header of the trace at path and start the reader
+ */
+tracestream_t *ts_open(const char *path, tracefmt_hdr_t *hdr)
+{
+	tracestream_t *ts;
+	char magic[5];
+	int i, nthreads;
+
+	if ((ts = calloc(1, sizeof(tracestream_t))) == NULL)
+		return NULL;
+	if ((ts->fp = fopen(path, "rb")) == NULL) {
+		free(ts);
+		return NULL;
+	}
+
+	ts->binary = fread(magic, 1, sizeof(magic), ts->fp) == sizeof(magic) &&
+		tracefmt_is_binary(magic, sizeof(magic));
+	ts->fixed = ts->binary && magic[4] == TRACEFMT_FIXED;
+	if (ts->fixed) {
+		if (tracefmt_read_fixed_hdr(ts->fp, hdr, &nthreads) < 0)
+			goto fail;
+	}
+	else if (ts->binary) {
+		if (magic[4] != TRACEFMT_VERSION || tracefmt_read_hdr(ts->fp, hdr) < 0)
+			goto fail;
+	}
+	else {
+		rewind(ts->fp);
+		if (fscanf(ts->fp, "%d %d %d %d", &hdr->sugg_heapsize, &hdr->num_ids,
+					&hdr->num_ops, &hdr->weight) != 4)
+			goto fail;
+	}
+
+	for (i = 0; i < NBUFS; i++)
+		if ((ts->bufs[i] = malloc(TS_CHUNKOPS * sizeof(tsop_t))) == NULL)
+			goto fail;
+	ts->held = -1;
+	pthread_mutex_init(&ts->lock, NULL);
+	pthread_cond_init(&ts->filled, NULL);
+	pthread_cond_init(&ts->emptied, NULL);
+	if (pthread_create(&ts->reader, NULL, reader, ts) != 0)
+		goto fail;
+	return ts;
+
+fail:
+	for (i = 0; i < NBUFS; i++)
+		free(ts->bufs[i]);
+	fclose(ts->fp);
+	free(ts);
+	return NULL;
+}
+
+/*
+ * ts_next - Release the chunk the caller holds and wait for the next
+ */
+int ts_next(tracestream_t *ts, tsop_t **ops)
+{
+	struct timeval stv, etv;
+	int n;
+
+	pthread_mutex_lock(&ts->lock);
+	if (ts->held >= 0) {
+		ts->held = -1;
+		pthread_cond_signal(&ts->emptied);
+	}
+	if (!ts->full[ts->head] && !ts->done) {
+		gettimeofday(&stv, NULL);
+		while (!ts->full[ts->head] && !ts->done)
+			pthread_cond_wait(&ts->filled, &ts->lock);
+		gettimeofday(&etv, NULL);
+		ts->stall += (etv.tv_sec - stv.tv_sec) + 1E-6*(etv.tv_usec - stv.tv_usec);
+	}
+	if (!ts->full[ts->head]) {
+		n = (ts->done < 0) ? -1 : 0;
+		pthread_mutex_unlock(&ts->lock);
+		return n;
+	}
+	*ops = ts->bufs[ts->head];
+	n = ts->counts[ts->head];
+	ts->full[ts->head] = 0;
+	ts->held = ts->head;
+	ts->head = (ts->head + 1) % NBUFS;
+	pthread_mutex_unlock(&ts->lock);
+	return n;
+}
+
+/*
+ * ts_stall_secs - Time spent waiting for the reader
+ */
+double ts_stall_secs(tracestream_t *ts)
+{
+	return ts->stall;
+}
+
+/*
+ * ts_close - Stop the reader and free everything
+ */
+void ts_close(tracestream_t *ts)
+{
+	int i;
+
+	pthread_mutex_lock(&ts->lock);
+	ts->stop = 1;
+	pthread_cond_signal(&ts->emptied);
+	pthread_mutex_unlock(&ts->lock);
+	pthread_join(ts->reader, NULL);
+
+	pthread_mutex_destroy(&ts->lock);
+	pthread_cond_destroy(&ts->filled);
+	pthread_cond_destroy(&ts->emptied);
+	for (i = 0; i < NBUFS; i++)
+		free(ts->bufs[i]);
+	fclose(ts->fp);
+	free(ts);
+}
@@ -0,0 +1,41 @@
+/*
+ * tracestream.h - Reads a trace in bounded chunks on a background thread
+ *
+ * Used to replay traces that are too large to hold in memory. A reader
+ * thread parses the trace, text or binary, into a small ring of
+ * fixed-size chunks while the caller replays the previous ones, so the
+ * memory used does not depend on the length of the trace.
+ */
+#ifndef __TRACESTREAM_H_
+#define __TRACESTREAM_H_
+
+#include "tracefmt.h"
+
+#define TS_CHUNKOPS 65536 /* ops in each chunk */
+
+/* One trace op; type is one of the TRACEFMT_* op types */
+typedef struct {
+	int type;
+	int id;
+	int size;
+} tsop_t;
+
+typedef struct tracestream tracestream_t;
+
+/* Open a trace and start reading it; NULL if it cannot be opened */
+tracestream_t *ts_open(const char *path, tracefmt_hdr_t *hdr);
+
+/*
+ * Wait for the next chunk and point *ops at it. Returns the number of
+ * ops in it, 0 at the end of the trace and -1 if the trace is malformed.
+ * The chunk stays valid until the next call.
+ */
+int ts_next(tracestream_t *ts, tsop_t **ops);
+
+/* Seconds the caller has spent waiting in ts_next */
+double ts_stall_secs(tracestream_t *ts);
+
+/* Stop the reader thread and free the stream */
+void ts_close(tracestream_t *ts);
+
+#endif /* __TRACESTREAM_H_ */